@@ -0,0 +1,355 @@
+#include "benchmark.hpp"
+
+#include "../drawing/sextantBlocks.hpp"
+#include "../rasterizer/rasterizer.hpp"
+#include "../rasterizer/scene.hpp"
+#include "../rasterizer/shapeBuilders.hpp"
+#include "../util/specularLut.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtx/euler_angles.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <memory_resource>
+#include <numeric>
+#include <print>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// FNV-1a over every sextant, so different engines/settings can be checked for identical output
+static uint64_t hashDrawing(const SextantDrawing& drawing) {
+	uint64_t hash = 14'695'981'039'346'656'037u;
+	auto mix = [&hash](const uchar byte) {
+		hash ^= byte;
+		hash *= 1'099'511'628'211u;
+	};
+	for (SextantCoord coord : drawing.getIterator()) {
+		Color color = drawing.get(coord);
+		mix(color.color.r);
+		mix(color.color.g);
+		mix(color.color.b);
+		mix(color.color.a);
+	}
+	return hash;
+}
+
+// binary PPM, one pixel per sextant, alpha dropped
+static void writeImage(const SextantDrawing& drawing, const std::string& path) {
+	std::ofstream file{path, std::ios::binary};
+	if (not file) throw std::runtime_error(std::format("Can't write to '{}'", path));
+	std::print(file, "P6\n{} {}\n255\n", drawing.getWidth(), drawing.getHeight());
+	for (int y = 0; y < drawing.getHeight(); y++) {
+		for (int x = 0; x < drawing.getWidth(); x++) {
+			RGBA color = drawing.get({y, x}).color;
+			file.put(color.r).put(color.g).put(color.b);
+		}
+	}
+}
+
+// Compares against a PPM from writeImage, so e.g. float and double builds can be checked against
+// each other. Prints how many sextants differ, and by how much.
+static void compareImage(const SextantDrawing& drawing, const std::string& path) {
+	std::ifstream file{path, std::ios::binary};
+	std::string magic;
+	int width, height, maxValue;
+	file >> magic >> width >> height >> maxValue;
+	file.get(); // the single whitespace before the pixels
+	if (not file or magic != "P6" or maxValue != 255)
+		throw std::runtime_error(std::format("'{}' isn't a PPM from --bench-dump", path));
+	if (height != drawing.getHeight() or width != drawing.getWidth())
+		throw std::runtime_error(std::format("'{}' is {}x{}, but the benchmark is {}x{}", path,
+		                                     height, width, drawing.getHeight(),
+		                                     drawing.getWidth()));
+
+	uint differing = 0;
+	int maxDifference = 0;
+	uint64_t totalDifference = 0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			RGBA color = drawing.get({y, x}).color;
+			int differences[3];
+			for (int& difference : differences) difference = file.get();
+			if (not file) throw std::runtime_error(std::format("'{}' is cut short", path));
+			differences[0] = std::abs(differences[0] - color.r);
+			differences[1] = std::abs(differences[1] - color.g);
+			differences[2] = std::abs(differences[2] - color.b);
+
+			int worst = std::max({differences[0], differences[1], differences[2]});
+			if (worst != 0) differing++;
+			maxDifference = std::max(maxDifference, worst);
+			totalDifference += differences[0] + differences[1] + differences[2];
+		}
+	}
+
+	std::println("compared to {}: {} of {} sextants differ, max channel difference {}, mean {:.4f}",
+	             path, differing, width * height, maxDifference,
+	             (double)totalDifference / (3.0 * width * height));
+}
+
+// Scatters small point lights around the scene's objects, the same ones every run. Each only
+// reaches a little way, so most of the scene is lit by a handful of them.
+static void addBenchLights(Scene& scene, const uint count) {
+	std::mt19937 random{2};
+	std::uniform_real_distribution<real> x{-2, 4.5}, y{-1, 5}, z{4, 11}, range{1, 3};
+	for (uint i = 0; i < count; i++) {
+		rvec3 position{x(random), y(random), z(random)};
+		scene.lights.push_back(std::make_shared<PointLight>(0.3, position, range(random)));
+	}
+}
+
+// lined up behind the cubes, getting further away, so they cover every level of detail
+static void addBenchSpheres(Scene& scene, const uint count) {
+	std::shared_ptr<Object3D> sphere = makeSphereWithLods(ccyan, 20, 0.5, 4);
+	for (uint i = 0; i < count; i++) {
+		Transform transform{rvec3{1, -1.5, 5 + 2 * static_cast<real>(i)}, glm::identity<rmat3>(),
+		                    1.0};
+		scene.instances.push_back(InstanceRef3D(sphere, transform));
+	}
+}
+
+// A forest of the same little tree on the ground below the cubes, turned every which way. They all
+// share one mesh, so they get transformed as instances of it.
+static void addBenchForest(Scene& scene, const uint count) {
+	constexpr uint ROW = 16; // trees across
+	auto tree = std::make_shared<Object3D>(Object3D{{}, {}, -1});
+	makePyramid(*tree, cgreen, {0, 0, 0}, {0, 1.5, 0}, {0.4, 0, 0});
+	for (uint i = 0; i < count; i++) {
+		rvec3 position{-4 + 0.6 * static_cast<real>(i % ROW), -2.5,
+		               4 + 0.6 * static_cast<real>(i / ROW)};
+		Transform transform{position, glm::yawPitchRoll<real>(0.7 * i, 0, 0), 1.0};
+		scene.instances.push_back(InstanceRef3D(tree, transform));
+	}
+}
+
+void runBenchmark(const ProgramOptions& options) {
+	SextantDrawing canvas{options.benchHeight, options.benchWidth};
+	Scene scene = initScene();
+	addBenchLights(scene, options.benchLights);
+	addBenchSpheres(scene, options.benchSpheres);
+	addBenchForest(scene, options.benchForest);
+	RenderContext context{options.render};
+
+	std::vector<double> frameTimes; // milliseconds
+	frameTimes.reserve(options.benchFrames);
+	size_t arenaTotal = 0; // bytes
+	uint arenaOverflows = 0; // frames that didn't fit in the arena
+	size_t verticesTransformed = 0, verticesCached = 0;
+	std::chrono::nanoseconds transformTime{0};
+	size_t instancesShaded = 0;
+	std::chrono::nanoseconds shadingSetupTime{0};
+	size_t shadowMapsDrawn = 0;
+	size_t instancesInView = 0;
+	size_t instancesOccluded = 0, trianglesOccluded = 0;
+	size_t trianglesSavedByLod = 0;
+	size_t instancesTransformed = 0, meshesTransformed = 0;
+	size_t trianglesClipped = 0;
+	size_t instancesCulledByBox = 0, planeTestsAvoided = 0;
+
+	for (uint frame = 0; frame < options.benchFrames; frame++) {
+		canvas.clear(Color{
+		    {false, 999},
+            {255, 255, 255, 255}
+        });
+
+		auto start = std::chrono::steady_clock::now();
+		renderScene(canvas, scene, context);
+		auto end = std::chrono::steady_clock::now();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		arenaTotal += context.arena.bytesUsed();
+		if (context.arena.overflowCount() != 0) arenaOverflows++;
+		verticesTransformed += context.stats.verticesTransformed;
+		verticesCached += context.stats.verticesCached;
+		transformTime += context.stats.transformTime;
+		instancesShaded += context.stats.instancesShaded;
+		shadingSetupTime += context.stats.shadingSetupTime;
+		shadowMapsDrawn += context.stats.shadowMapsDrawn;
+		instancesInView += context.stats.instancesInView;
+		instancesOccluded += context.stats.instancesOccluded;
+		trianglesOccluded += context.stats.trianglesOccluded;
+		trianglesSavedByLod += context.stats.trianglesSavedByLod;
+		instancesTransformed += context.stats.instancesTransformed;
+		meshesTransformed += context.stats.meshesTransformed;
+		trianglesClipped += context.stats.trianglesClipped;
+		instancesCulledByBox += context.stats.instancesCulledByBox;
+		planeTestsAvoided += context.stats.planeTestsAvoided;
+
+		// pan back and forth so frames differ, but the same way every run
+		double yaw = (frame / 50) % 2 == 0 ? 0.01 : -0.01;
+		if (options.benchStatic and not scene.instances.empty()) {
+			Transform transform = scene.instances[0].getTransform();
+			transform.rotation = rmat3(glm::yawPitchRoll<real>(yaw, 0, 0)) * transform.rotation;
+			scene.instances[0].setTransform(transform);
+		} else {
+			scene.camera.translateBy({
+			    {0, 0, 0},
+                glm::yawPitchRoll<real>(yaw, 0, 0), 1
+            });
+		}
+	}
+
+	if (frameTimes.empty()) return;
+	double total = std::accumulate(ALL_OF(frameTimes), 0.0);
+	std::vector<double> sorted = frameTimes;
+	std::sort(ALL_OF(sorted));
+
+	std::println("engine: {}{}, shading: {}, precision: {}, threads: {}, frames: {}, size: {}x{}",
+	             engineName(options.render.engine), options.render.deferred ? " (deferred)" : "",
+	             shadingModeName(options.render.shading),
+	             sizeof(real) == sizeof(float) ? "float" : "double",
+	             options.render.threads == 0 ? std::thread::hardware_concurrency()
+	                                         : options.render.threads,
+	             frameTimes.size(), options.benchHeight, options.benchWidth);
+	std::println("frame time (ms): mean {:.3f}, median {:.3f}, min {:.3f}, max {:.3f}",
+	             total / frameTimes.size(), sorted[sorted.size() / 2], sorted.front(),
+	             sorted.back());
+	std::println("instances: {}, {:.1f} in view on average", scene.instances.size(),
+	             (double)instancesInView / frameTimes.size());
+	if (options.render.occluders != 0)
+		std::println("occlusion culled/frame: {:.1f} instances, {:.1f} triangles",
+		             (double)instancesOccluded / frameTimes.size(),
+		             (double)trianglesOccluded / frameTimes.size());
+	if (options.render.lod)
+		std::println("triangles saved by levels of detail/frame: {:.1f}",
+		             (double)trianglesSavedByLod / frameTimes.size());
+	std::println("triangles clipped/frame: {:.1f}{}", (double)trianglesClipped / frameTimes.size(),
+	             options.render.guardBand ? " (guard band)" : "");
+	std::println("bounding boxes/frame: {:.1f} more instances culled, {:.1f} plane tests avoided",
+	             (double)instancesCulledByBox / frameTimes.size(),
+	             (double)planeTestsAvoided / frameTimes.size());
+	if (context.activeLightGrid() != NULL)
+		std::println("lights: {}, {:.1f} per cluster on average (last frame)", scene.lights.size(),
+		             context.lightGrid.averageLights());
+	else std::println("lights: {}, not culled", scene.lights.size());
+	if (options.render.shadows)
+		std::println("shadow maps drawn/frame: {:.2f}",
+		             (double)shadowMapsDrawn / frameTimes.size());
+	std::println("arena (KiB/frame): mean {:.1f}, max {:.1f}; frames that overflowed it: {}",
+	             arenaTotal / 1024.0 / frameTimes.size(),
+	             context.arena.peakBytesUsed() / 1024.0, arenaOverflows);
+	std::println("vertices/frame: {:.1f} transformed, {:.1f} from the cache",
+	             (double)verticesTransformed / frameTimes.size(),
+	             (double)verticesCached / frameTimes.size());
+	std::println("instances transformed/frame: {:.1f}, from {:.1f} different meshes",
+	             (double)instancesTransformed / frameTimes.size(),
+	             (double)meshesTransformed / frameTimes.size());
+	// nothing's transformed when everything's cached, so there's no rate to give
+	if (verticesTransformed != 0)
+		std::println("vertex transform: {:.1f} Mverts/s",
+		             verticesTransformed / std::chrono::duration<double>(transformTime).count()
+		                 / 1e6);
+	// what every instance costs before its triangles are binned, which a forest has lots of
+	if (instancesShaded != 0)
+		std::println("instance shading setup: {:.1f} ns each, {:.1f} instances/frame",
+		             (double)shadingSetupTime.count() / instancesShaded,
+		             (double)instancesShaded / frameTimes.size());
+	std::println("last frame hash: {:016x}", hashDrawing(canvas));
+
+	if (not options.benchDump.empty()) writeImage(canvas, options.benchDump);
+	if (not options.benchCompare.empty()) compareImage(canvas, options.benchCompare);
+}
+
+void runSpecularBenchmark() {
+	// Mostly cosines near 1, like real highlights, where big exponents are hardest to tabulate.
+	// The same inputs go to both, so only the lookup itself differs.
+	constexpr int SAMPLES = 1'000'000;
+	std::mt19937 random{1};
+	std::uniform_real_distribution<double> uniform{0, 1};
+	std::vector<double> cosines(SAMPLES);
+	for (int i = 0; i < SAMPLES; i++) {
+		double spread = uniform(random);
+		cosines[i] = i % 2 == 0 ? spread : 1 - spread * spread * spread * 0.1;
+	}
+
+	std::println("{:>10} {:>12} {:>12} {:>12} {:>12}", "exponent", "pow (ns)", "table (ns)",
+	             "max error", "mean error");
+	for (double exponent : {1.0, 3.0, 10.0, 32.5, 100.0, 500.0, 1000.0}) {
+		const SpecularLut& table = specularLutFor(exponent);
+		std::vector<double> exact(SAMPLES);
+		std::vector<double> tabulated(SAMPLES);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < SAMPLES; i++) {
+			exact[i] = std::pow(cosines[i], exponent);
+		}
+		auto middle = std::chrono::steady_clock::now();
+		for (int i = 0; i < SAMPLES; i++) {
+			tabulated[i] = table.at(cosines[i]);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double maxError = 0;
+		double totalError = 0;
+		for (int i = 0; i < SAMPLES; i++) {
+			double error = std::abs(exact[i] - tabulated[i]);
+			maxError = std::max(maxError, error);
+			totalError += error;
+		}
+
+		std::println("{:>10} {:>12.2f} {:>12.2f} {:>12.6f} {:>12.6f}", exponent,
+		             std::chrono::duration<double, std::nano>(middle - start).count() / SAMPLES,
+		             std::chrono::duration<double, std::nano>(end - middle).count() / SAMPLES,
+		             maxError, totalError / SAMPLES);
+	}
+}
+
+void runClipBenchmark() {
+	// Triangles of all sizes scattered around the default camera, the same ones every run. Only
+	// the ones crossing a plane are timed, since nothing else ever gets clipped.
+	constexpr uint SAMPLES = 200'000;
+	Camera camera = initScene().camera;
+	std::mt19937 random{3};
+	std::uniform_real_distribution<real> across{-4, 4}, depth{-1, 8}, size{-1.5, 1.5};
+	std::vector<rvec3> corners;
+	corners.reserve(3 * SAMPLES);
+	for (uint i = 0; i < SAMPLES; i++) {
+		rvec3 center{across(random), across(random), depth(random)};
+		for (uint j = 0; j < 3; j++) {
+			corners.push_back(center + rvec3{size(random), size(random), size(random)});
+		}
+	}
+
+	std::println("{:>12} {:>10} {:>10} {:>14} {:>14}", "planes", "crossing", "ns/tri",
+	             "tris out/tri", "points out/tri");
+	std::pair<const char*, std::vector<Plane>> planeSets[]{
+	    {"view",       camera.getClippingPlanes()           },
+	    {"guard band", camera.getClippingPlanes(GUARD_BAND)}
+    };
+	for (const auto& [name, planes] : planeSets) {
+		std::pmr::monotonic_buffer_resource memory;
+		std::pmr::vector<rvec3> points{corners.begin(), corners.end(), &memory};
+		std::vector<ColoredTriangle> crossing;
+		for (uint i = 0; i < SAMPLES; i++) {
+			Triangle<rvec3> vertices{corners[3 * i], corners[3 * i + 1], corners[3 * i + 2]};
+			rvec3 normal = glm::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]);
+			if (glm::length(normal) == 0) continue;
+			normal = glm::normalize(normal);
+			if (classifyTriangle(vertices, planes) != PlaneSide::Crossing) continue;
+			crossing.push_back({
+			    {3 * i, 3 * i + 1, 3 * i + 2},
+			    cgreen, {normal, normal, normal}
+            });
+		}
+
+		ClipBuffer clipped{points, &memory};
+		auto start = std::chrono::steady_clock::now();
+		for (const ColoredTriangle& triangle : crossing) {
+			clipIntoBuffer(clipped, triangle, planes);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		std::println("{:>12} {:>10} {:>10.2f} {:>14.3f} {:>14.3f}", name, crossing.size(),
+		             std::chrono::duration<double, std::nano>(end - start).count()
+		                 / crossing.size(),
+		             (double)clipped.getTriangles().size() / crossing.size(),
+		             (double)(points.size() - corners.size()) / crossing.size());
+	}
+}
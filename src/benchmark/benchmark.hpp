@@ -0,0 +1,16 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+#include "../rasterizer/settings.hpp"
+
+// Renders options.benchFrames frames of the default scene without touching the terminal, then
+// prints frame timings to stdout. Run it once per engine/setting to compare them.
+void runBenchmark(const ProgramOptions& options);
+
+// Times the specular tables against pow for a few exponents, and prints how far off they are.
+void runSpecularBenchmark();
+
+// Times clipIntoBuffer on random triangles crossing the view's planes (and the guard band's), and
+// prints how much geometry clipping makes.
+void runClipBenchmark();
+
+#endif /* BENCHMARK_HPP */
@@ -1,7 +1,10 @@
+#include "benchmark/benchmark.hpp"
 #include "rasterizer/controller.hpp"
+#include "rasterizer/settings.hpp"
 #include <clocale>
 #include <csignal>
 #include <exception>
+#include <stdexcept>
 #include <fcntl.h>
 #include <notcurses/notcurses.h>
 #include <sys/stat.h>
@@ -46,9 +49,32 @@ void sigHandle([[maybe_unused]] int sig) {
 	}
 }
 
-int main() {
+int main(int argc, char** argv) {
 	std::set_terminate(termHandler);
 
+	ProgramOptions options;
+	try {
+		options = parseArgs(argc, argv);
+	} catch (std::runtime_error& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	if (options.benchSpecular) {
+		runSpecularBenchmark();
+		return 0;
+	}
+
+	if (options.benchClip) {
+		runClipBenchmark();
+		return 0;
+	}
+
+	if (options.benchFrames != 0) { // no terminal needed
+		runBenchmark(options);
+		return 0;
+	}
+
 	// make interrups exit nicely
 	signal(SIGINT, sigHandle);
 	signal(SIGTERM, sigHandle);
@@ -57,7 +83,7 @@ int main() {
 	notcurses* nc = notcurses_core_init(NULL, stdout);
 	ncplane* stdplane = notcurses_stdplane(nc);
 
-	renderLoop(nc, stdplane, EXIT_REQUESTED);
+	renderLoop(nc, stdplane, EXIT_REQUESTED, options.render);
 
 	notcurses_stop(nc);
 	return 0;
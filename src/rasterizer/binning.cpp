@@ -0,0 +1,97 @@
+#include "binning.hpp"
+
+#include <algorithm>
+#include <utility>
+
+TriangleBins::TriangleBins(const int height, const int width) {
+	this->resize(height, width);
+}
+
+void TriangleBins::resize(const int height, const int width) {
+	assertMsg(this->triangles.empty(), "Can't resize bins that still have triangles.");
+	this->height = height;
+	this->width = width;
+	// round up, so partial bins at the edges get one too
+	this->bins.resize(
+	    boost::extents[(height + BIN_SIZE - 1) / BIN_SIZE][(width + BIN_SIZE - 1) / BIN_SIZE]);
+}
+
+InstanceShading& TriangleBins::addInstance(uint& index) {
+	if (this->instanceCount == this->instances.size()) this->instances.emplace_back();
+	index = this->instanceCount++;
+	return this->instances[index];
+}
+
+void TriangleBins::addTriangle(const ScreenTriangle& triangle) {
+	assertLt(triangle.instance, this->instanceCount, "Triangle from an unknown instance.");
+
+	// bounding box, clipped to the canvas
+	ScreenRect bounds = subpixelBounds(triangle.points, {this->width, this->height});
+	int minCol = std::max(0, bounds.minCol);
+	int maxCol = std::min(this->width - 1, bounds.maxCol);
+	int minRow = std::max(0, bounds.minRow);
+	int maxRow = std::min(this->height - 1, bounds.maxRow);
+	if (minCol > maxCol or minRow > maxRow) return; // fully offscreen
+
+	uint index = this->triangles.size();
+	this->triangles.push_back(triangle);
+
+	// randomize colors so tris can be distinguished
+	// done here, and not while drawing, so every bin gets the same color
+	if (debugFrame) {
+		this->triangles.back().color = Color{
+		    triangle.color.category,
+		    {static_cast<uchar>(rand() % 255), static_cast<uchar>(rand() % 255),
+		               static_cast<uchar>(rand() % 255), 255}
+        };
+	}
+
+	for (int binRow = minRow / BIN_SIZE; binRow <= maxRow / BIN_SIZE; binRow++) {
+		for (int binCol = minCol / BIN_SIZE; binCol <= maxCol / BIN_SIZE; binCol++) {
+			this->bins[binRow][binCol].push_back(index);
+		}
+	}
+}
+
+void TriangleBins::renderBin(SextantDrawing& canvas, DepthBuffer& depthBuffer, GBuffer* gBuffer,
+                             const RenderSettings& settings, const Camera& camera,
+                             const int binRow, const int binCol) const {
+	ScreenRect scissor{binRow * BIN_SIZE, binCol * BIN_SIZE,
+	                   std::min(this->height, (binRow + 1) * BIN_SIZE) - 1,
+	                   std::min(this->width, (binCol + 1) * BIN_SIZE) - 1};
+
+	for (uint index : this->bins[binRow][binCol]) {
+		const ScreenTriangle& triangle = this->triangles[index];
+		const InstanceShading& instance = this->instances[triangle.instance];
+		renderTriangle(canvas, depthBuffer, gBuffer, settings, scissor, triangle.points,
+		               triangle.depth, triangle.normals, triangle.lighting, triangle.color, camera,
+		               instance);
+	}
+}
+
+void TriangleBins::flush(SextantDrawing& canvas, DepthBuffer& depthBuffer, GBuffer* gBuffer,
+                         const RenderSettings& settings, const Camera& camera, ThreadPool& pool) {
+	assertEq(canvas.getHeight(), this->height, "Bins must match the canvas.");
+	assertEq(canvas.getWidth(), this->width, "Bins must match the canvas.");
+
+	// empty bins would only cost the pool a job each
+	std::vector<std::pair<int, int>>& occupied = this->occupied;
+	occupied.clear();
+	for (int binRow = 0; binRow < (int)this->bins.shape()[0]; binRow++) {
+		for (int binCol = 0; binCol < (int)this->bins.shape()[1]; binCol++) {
+			if (not this->bins[binRow][binCol].empty()) occupied.push_back({binRow, binCol});
+		}
+	}
+
+	pool.parallelFor(occupied.size(), [&](const size_t job) {
+		this->renderBin(canvas, depthBuffer, gBuffer, settings, camera, occupied[job].first,
+		                occupied[job].second);
+	});
+
+	// keep the bins' capacity around for the next batch
+	for (const auto& [binRow, binCol] : occupied) {
+		this->bins[binRow][binCol].clear();
+	}
+	this->triangles.clear();
+	this->instanceCount = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef BINNING_HPP
+#define BINNING_HPP
+#include "../drawing/sextantBlocks.hpp"
+#include "../util/threadPool.hpp"
+#include "deferred.hpp"
+#include "depthBuffer.hpp"
+#include "renderable.hpp"
+#include "settings.hpp"
+#include "triangles.hpp"
+
+#include <boost/multi_array.hpp>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// side length of the square screen regions triangles are sorted into
+// a whole number of depth buffer tiles, so no two bins ever touch the same tile
+constexpr int BIN_SIZE = 4 * TILE_SIZE;
+static_assert(BIN_SIZE % TILE_SIZE == 0);
+
+// a projected triangle, waiting to be rasterized
+struct ScreenTriangle {
+	Triangle<ivec2> points; // canvas coordinates (origin at center), in subpixels
+	Triangle<float> depth;
+	Triangle<rvec3> normals;
+	Triangle<real> lighting; // per vertex, only used for Gouraud shading
+	Color color;
+	uint instance; // index into TriangleBins' instances
+};
+
+// Sort-middle rendering: projected triangles are collected into screen space bins, then every bin
+// is rasterized on its own, in parallel.
+// Each bin draws its triangles in the order they were added and only touches its own sextants, so
+// the output is identical no matter how many threads there are.
+class TriangleBins {
+  private:
+	// slots are reused across flushes (only the first instanceCount are live)
+	std::vector<InstanceShading> instances;
+	uint instanceCount = 0;
+	std::vector<ScreenTriangle> triangles;
+	boost::multi_array<std::vector<uint>, 2> bins; // indices into triangles, coords are (y, x)
+	std::vector<std::pair<int, int>> occupied; // scratch for flush
+	int height;
+	int width;
+
+	void renderBin(SextantDrawing& canvas, DepthBuffer& depthBuffer, GBuffer* gBuffer,
+	               const RenderSettings& settings, const Camera& camera, const int binRow,
+	               const int binCol) const;
+
+  public:
+	TriangleBins(const int height, const int width);
+
+	[[nodiscard]] int getWidth() const { return this->width; }
+
+	[[nodiscard]] int getHeight() const { return this->height; }
+
+	[[nodiscard]] size_t triangleCount() const { return this->triangles.size(); }
+
+	// Hands out a slot for the next instance, and its index for ScreenTriangle::instance.
+	// The slot still holds whatever an earlier instance left in it, so set every field.
+	InstanceShading& addInstance(uint& index);
+	void addTriangle(const ScreenTriangle& triangle);
+
+	// only while empty, i.e. right after a flush
+	void resize(const int height, const int width);
+
+	// draws everything added so far, then forgets it
+	void flush(SextantDrawing& canvas, DepthBuffer& depthBuffer, GBuffer* gBuffer,
+	           const RenderSettings& settings, const Camera& camera, ThreadPool& pool);
+};
+
+#endif /* BINNING_HPP */
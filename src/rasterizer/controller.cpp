@@ -8,11 +8,13 @@
 
 bool debugFrame;
 
-void renderLoop(notcurses* nc, ncplane* plane, const bool& exitRequested) {
+void renderLoop(notcurses* nc, ncplane* plane, const bool& exitRequested,
+                const RenderSettings& settings) {
 	WindowedDrawing finalDrawing{plane};
 	int minDimension = std::min(finalDrawing.getHeight(), finalDrawing.getWidth());
 	SextantDrawing squareDrawing{minDimension, minDimension};
 	Scene scene = initScene();
+	RenderContext context{settings};
 
 	while (not exitRequested) {
 		ncinput key;
@@ -31,49 +33,49 @@ void renderLoop(notcurses* nc, ncplane* plane, const bool& exitRequested) {
 			case 'w':
 				transform = {
 				    {0, 0, 1},
-                    glm::yawPitchRoll<double>(0, 0, 0), 1
+                    glm::yawPitchRoll<real>(0, 0, 0), 1
                 };
 				break;
 			case 's':
 				transform = {
 				    {0, 0, -1},
-                    glm::yawPitchRoll<double>(0, 0, 0), 1
+                    glm::yawPitchRoll<real>(0, 0, 0), 1
                 };
 				break;
 			case 'q':
 				transform = {
 				    {-1, 0, 0},
-                    glm::yawPitchRoll<double>(0, 0, 0), 1
+                    glm::yawPitchRoll<real>(0, 0, 0), 1
                 };
 				break;
 			case 'e':
 				transform = {
 				    {1, 0, 0},
-                    glm::yawPitchRoll<double>(0, 0, 0), 1
+                    glm::yawPitchRoll<real>(0, 0, 0), 1
                 };
 				break;
 			case 'r':
 				transform = {
 				    {0, 1, 0},
-                    glm::yawPitchRoll<double>(0, 0, 0), 1
+                    glm::yawPitchRoll<real>(0, 0, 0), 1
                 };
 				break;
 			case 'f':
 				transform = {
 				    {0, -1, 0},
-                    glm::yawPitchRoll<double>(0, 0, 0), 1
+                    glm::yawPitchRoll<real>(0, 0, 0), 1
                 };
 				break;
 			case 'a':
 				transform = {
 				    {0, 0, 0},
-                    glm::yawPitchRoll<double>(0.1, 0, 0), 1
+                    glm::yawPitchRoll<real>(0.1, 0, 0), 1
                 };
 				break;
 			case 'd':
 				transform = {
 				    {0, 0, 0},
-                    glm::yawPitchRoll<double>(-0.1, 0, 0), 1
+                    glm::yawPitchRoll<real>(-0.1, 0, 0), 1
                 };
 				break;
 			case 'x': debugFrame = true; break;
@@ -95,7 +97,7 @@ void renderLoop(notcurses* nc, ncplane* plane, const bool& exitRequested) {
 		    {false, 999},
             {0, 0, 0, 0}
         });
-		renderScene(squareDrawing, scene);
+		renderScene(squareDrawing, scene, context);
 
 		// draw a blue plus across the screen
 		for (int i = 0; i < squareDrawing.getHeight(); i++) {
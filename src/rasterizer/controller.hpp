@@ -5,6 +5,7 @@
 // this code bridges the renderer and notcurses
 // it also lets you move, which is nice
 
-void renderLoop(notcurses* nc, ncplane* plane, const bool& exitRequested);
+void renderLoop(notcurses* nc, ncplane* plane, const bool& exitRequested,
+                const RenderSettings& settings);
 
 #endif /* CONTROLLER_HPP */
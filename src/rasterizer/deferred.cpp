@@ -0,0 +1,74 @@
+#include "deferred.hpp"
+
+#include "shadeKernel.hpp"
+#include "structures.hpp"
+#include "triangles.hpp"
+
+#include <algorithm>
+
+GBuffer::GBuffer(const int height, const int width) {
+	this->resize(height, width);
+}
+
+void GBuffer::resize(const int height, const int width) {
+	assertGtEq(height, 0, "height must be positive");
+	assertGtEq(width, 0, "width must be positive");
+	this->texels.resize(boost::extents[height][width]);
+	this->clear();
+}
+
+void GBuffer::clear() {
+	GBufferTexel empty{0, origin, origin, Color(), -1, NULL};
+	std::fill_n(this->texels.data(), this->texels.num_elements(), empty);
+}
+
+void shadeGBuffer(SextantDrawing& canvas, const GBuffer& gBuffer, const real ambientLight,
+                  const LightTable& lights, const LightGrid* lightGrid, ThreadPool& pool) {
+	assertEq(canvas.getHeight(), gBuffer.getHeight(), "G-buffer must match the canvas.");
+	assertEq(canvas.getWidth(), gBuffer.getWidth(), "G-buffer must match the canvas.");
+
+	// every texel is independent, so any split works; a row per job is plenty
+	pool.parallelFor(gBuffer.getHeight(), [&](const size_t row) {
+		// covered texels are gathered up and lit SHADE_BATCH at a time
+		LightingBatch batch;
+		int rows[SHADE_BATCH];
+		int cols[SHADE_BATCH];
+		real invDepths[SHADE_BATCH];
+		std::fill_n(rows, SHADE_BATCH, row);
+		auto flush = [&]() {
+			if (batch.count == 0) return;
+			padBatch(batch);
+			LightMask mask;
+			if (lightGrid != NULL) lightGrid->gather(rows, cols, invDepths, batch.count, mask);
+			real intensities[SHADE_BATCH];
+			// the camera is at the origin in camera space
+			computeLightingBatch(batch, origin, ambientLight, lights,
+			                     lightGrid != NULL ? &mask : NULL, intensities);
+			for (int i = 0; i < batch.count; i++) {
+				const GBufferTexel& texel = gBuffer.get(row, cols[i]);
+				canvas.set(SextantCoord(row, cols[i]),
+				           Color(texel.baseColor.category, texel.baseColor.color * intensities[i]));
+			}
+			batch.count = 0;
+		};
+
+		for (int col = 0; col < gBuffer.getWidth(); col++) {
+			const GBufferTexel& texel = gBuffer.get(row, col);
+			if (texel.invDepth == 0) continue; // nothing drawn, so leave the background
+
+			int i = batch.count++;
+			cols[i] = col;
+			invDepths[i] = texel.invDepth;
+			batch.pointX[i] = texel.position.x;
+			batch.pointY[i] = texel.position.y;
+			batch.pointZ[i] = texel.position.z;
+			batch.normalX[i] = texel.normal.x;
+			batch.normalY[i] = texel.normal.y;
+			batch.normalZ[i] = texel.normal.z;
+			batch.specular[i] = texel.specular;
+			batch.specularLut[i] = texel.specularLut;
+			if (batch.count == SHADE_BATCH) flush();
+		}
+		flush();
+	});
+}
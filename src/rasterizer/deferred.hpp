@@ -0,0 +1,56 @@
+#ifndef DEFERRED_HPP
+#define DEFERRED_HPP
+#include "../drawing/sextantBlocks.hpp"
+#include "../util/threadPool.hpp"
+#include "lightGrid.hpp"
+#include "renderable.hpp"
+#include "shadeKernel.hpp"
+
+#include <boost/multi_array.hpp>
+
+#include <memory>
+#include <vector>
+
+// everything the lighting pass needs to shade one visible sextant
+// positions and normals are in camera space
+struct GBufferTexel {
+	float invDepth; // 0 if nothing was drawn here
+	rvec3 normal;
+	rvec3 position;
+	Color baseColor; // also holds the category
+	real specular;
+	const SpecularLut* specularLut; // NULL to use pow
+};
+
+// Geometry buffer for deferred shading.
+// Rasterization fills it in, then shadeGBuffer lights each covered sextant exactly once, no matter
+// how many triangles were drawn over it.
+class GBuffer {
+  private:
+	boost::multi_array<GBufferTexel, 2> texels; // coords are (y, x), like the canvas
+
+  public:
+	GBuffer(const int height, const int width);
+
+	[[nodiscard]] int getWidth() const { return this->texels.shape()[1]; }
+
+	[[nodiscard]] int getHeight() const { return this->texels.shape()[0]; }
+
+	[[nodiscard]] const GBufferTexel& get(const int row, const int col) const {
+		return this->texels[row][col];
+	}
+
+	void set(const int row, const int col, const GBufferTexel& texel) {
+		this->texels[row][col] = texel;
+	}
+
+	void resize(const int height, const int width);
+	void clear();
+};
+
+// the lighting pass, split across the pool by rows
+// lights must already be in camera space, and lightGrid built from them (or NULL to use them all)
+void shadeGBuffer(SextantDrawing& canvas, const GBuffer& gBuffer, const real ambientLight,
+                  const LightTable& lights, const LightGrid* lightGrid, ThreadPool& pool);
+
+#endif /* DEFERRED_HPP */
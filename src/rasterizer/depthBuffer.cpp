@@ -0,0 +1,80 @@
+#include "depthBuffer.hpp"
+
+DepthBuffer::DepthBuffer(const int height, const int width) {
+	this->resize(height, width);
+}
+
+void DepthBuffer::resize(const int height, const int width) {
+	assertGtEq(height, 0, "height must be positive");
+	assertGtEq(width, 0, "width must be positive");
+	this->depths.resize(boost::extents[height][width]);
+
+	// round up, so partial tiles at the edges get one too
+	int tilesHigh = (height + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesWide = (width + TILE_SIZE - 1) / TILE_SIZE;
+	this->tileFarthest.resize(boost::extents[tilesHigh][tilesWide]);
+	this->tileNearest.resize(boost::extents[tilesHigh][tilesWide]);
+	this->tileStale.resize(boost::extents[tilesHigh][tilesWide]);
+
+	this->clear();
+}
+
+void DepthBuffer::clear() {
+	std::fill_n(this->depths.data(), this->depths.num_elements(), 0);
+	std::fill_n(this->tileFarthest.data(), this->tileFarthest.num_elements(), 0);
+	std::fill_n(this->tileNearest.data(), this->tileNearest.num_elements(), 0);
+	std::fill_n(this->tileStale.data(), this->tileStale.num_elements(), false);
+}
+
+void DepthBuffer::refreshTile(const int tileRow, const int tileCol) const {
+	int endRow = std::min(this->getHeight(), (tileRow + 1) * TILE_SIZE);
+	int endCol = std::min(this->getWidth(), (tileCol + 1) * TILE_SIZE);
+
+	float farthest = std::numeric_limits<float>::infinity();
+	for (int row = tileRow * TILE_SIZE; row < endRow; row++) {
+		for (int col = tileCol * TILE_SIZE; col < endCol; col++) {
+			farthest = std::min(farthest, this->depths[row][col]);
+		}
+	}
+
+	this->tileFarthest[tileRow][tileCol] = farthest;
+	this->tileStale[tileRow][tileCol] = false;
+}
+
+bool DepthBuffer::rectHidden(int minRow, int minCol, int maxRow, int maxCol,
+                             const float nearestInvDepth) const {
+	minRow = std::max(minRow, 0);
+	minCol = std::max(minCol, 0);
+	maxRow = std::min(maxRow, this->getHeight() - 1);
+	maxCol = std::min(maxCol, this->getWidth() - 1);
+	if (minRow > maxRow or minCol > maxCol) return true; // nothing onscreen to draw on
+
+	for (int tileRow = minRow / TILE_SIZE; tileRow <= maxRow / TILE_SIZE; tileRow++) {
+		for (int tileCol = minCol / TILE_SIZE; tileCol <= maxCol / TILE_SIZE; tileCol++) {
+			// the depth test is strict, so equal counts as hidden
+			if (this->tileFarthest[tileRow][tileCol] >= nearestInvDepth) continue;
+			if (not this->tileStale[tileRow][tileCol]) return false;
+
+			this->refreshTile(tileRow, tileCol);
+			if (this->tileFarthest[tileRow][tileCol] < nearestInvDepth) return false;
+		}
+	}
+
+	return true;
+}
+
+bool DepthBuffer::rectInFront(int minRow, int minCol, int maxRow, int maxCol,
+                              const float farthestInvDepth) const {
+	minRow = std::max(minRow, 0);
+	minCol = std::max(minCol, 0);
+	maxRow = std::min(maxRow, this->getHeight() - 1);
+	maxCol = std::min(maxCol, this->getWidth() - 1);
+
+	for (int tileRow = minRow / TILE_SIZE; tileRow <= maxRow / TILE_SIZE; tileRow++) {
+		for (int tileCol = minCol / TILE_SIZE; tileCol <= maxCol / TILE_SIZE; tileCol++) {
+			if (this->tileNearest[tileRow][tileCol] >= farthestInvDepth) return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,72 @@
+#ifndef DEPTHBUFFER_HPP
+#define DEPTHBUFFER_HPP
+#include "../extraAssertions.hpp"
+
+#include <boost/multi_array.hpp>
+
+#include <algorithm>
+#include <limits>
+
+// side length of the square blocks of sextants the tiled engine and hierarchical z work on
+constexpr int TILE_SIZE = 8;
+
+// a rectangle of buffer coordinates (origin at top left), bounds inclusive
+struct ScreenRect {
+	int minRow;
+	int minCol;
+	int maxRow;
+	int maxCol;
+};
+
+// A depth buffer with a coarse level on top of it, for rejecting whole tiles at once.
+// Everything stored is inverse depth, so bigger is closer and 0 is empty (infinitely far away).
+//
+// Each tile keeps the nearest and farthest value in it. The nearest is updated on every write.
+// The farthest can only go up when something is written, so an out of date one is still a safe
+// (if pessimistic) bound; it's only recomputed when a test would otherwise fail because of it.
+class DepthBuffer {
+  private:
+	boost::multi_array<float, 2> depths; // coords are (y, x), like the canvas
+	mutable boost::multi_array<float, 2> tileFarthest; // coords are (tile y, tile x)
+	boost::multi_array<float, 2> tileNearest;
+	mutable boost::multi_array<bool, 2> tileStale; // if tileFarthest might be too low
+
+	void refreshTile(const int tileRow, const int tileCol) const;
+
+  public:
+	DepthBuffer(const int height, const int width);
+
+	[[nodiscard]] int getWidth() const { return this->depths.shape()[1]; }
+
+	[[nodiscard]] int getHeight() const { return this->depths.shape()[0]; }
+
+	[[nodiscard]] bool contains(const int row, const int col) const {
+		return 0 <= row and row < this->getHeight() and 0 <= col and col < this->getWidth();
+	}
+
+	[[nodiscard]] float get(const int row, const int col) const { return this->depths[row][col]; }
+
+	// only for values that passed the depth test, i.e. are closer than what's there
+	void set(const int row, const int col, const float invDepth) {
+		assertGtEq(invDepth, this->depths[row][col], "Depth buffer writes must be closer.");
+		this->depths[row][col] = invDepth;
+		float& nearest = this->tileNearest[row / TILE_SIZE][col / TILE_SIZE];
+		nearest = std::max(nearest, invDepth);
+		this->tileStale[row / TILE_SIZE][col / TILE_SIZE] = true;
+	}
+
+	// Whether nothing at or farther than nearestInvDepth could pass the depth test anywhere in
+	// the rectangle (inclusive, clipped to the buffer).
+	[[nodiscard]] bool rectHidden(int minRow, int minCol, int maxRow, int maxCol,
+	                              const float nearestInvDepth) const;
+
+	// Whether everything in the rectangle would pass the depth test for anything at or nearer than
+	// farthestInvDepth, so the test can be skipped. Same bounds as rectHidden.
+	[[nodiscard]] bool rectInFront(int minRow, int minCol, int maxRow, int maxCol,
+	                               const float farthestInvDepth) const;
+
+	void resize(const int height, const int width);
+	void clear();
+};
+
+#endif /* DEPTHBUFFER_HPP */
@@ -0,0 +1,146 @@
+#include "instanceBvh.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// Boxes are only culled if they're outside by more than this (relative to their size and
+// distance), so rounding in moving planes to world space can't cull anything the exact test in
+// camera space would have kept.
+constexpr real CULL_SLACK = 1e-4;
+
+// deepest the tree can get, since every split halves the instances
+constexpr int BVH_MAX_DEPTH = 64;
+
+static real surfaceArea(const BoundingBox& box) {
+	rvec3 size = box.max - box.min;
+	return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static BoundingBox sphereBox(const Sphere& sphere) {
+	return {sphere.center - sphere.radius, sphere.center + sphere.radius};
+}
+
+static BoundingBox join(const BoundingBox& a, const BoundingBox& b) {
+	return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+uint32_t InstanceBvh::build(const uint32_t first, const uint32_t count) {
+	uint32_t index = this->nodes.size();
+	this->nodes.push_back({{}, first, count, 0});
+	if (count <= BVH_LEAF_SIZE) return index;
+
+	// split at the median center, along the axis they're most spread out on
+	rvec3 low{std::numeric_limits<real>::infinity()};
+	rvec3 high{-std::numeric_limits<real>::infinity()};
+	for (uint32_t i = first; i < first + count; i++) {
+		low = glm::min(low, this->worldBounds[this->order[i]].center);
+		high = glm::max(high, this->worldBounds[this->order[i]].center);
+	}
+	rvec3 spread = high - low;
+	int axis = spread.x >= spread.y and spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+
+	uint32_t half = count / 2;
+	auto begin = this->order.begin() + first;
+	std::nth_element(begin, begin + half, begin + count, [&](uint32_t a, uint32_t b) {
+		return this->worldBounds[a].center[axis] < this->worldBounds[b].center[axis];
+	});
+	this->build(first, half);
+	uint32_t right = this->build(first + half, count - half);
+	this->nodes[index].right = right; // not a reference, since building reallocates
+	return index;
+}
+
+void InstanceBvh::refit() {
+	// children always come after their parents
+	for (size_t i = this->nodes.size(); i-- > 0;) {
+		Node& node = this->nodes[i];
+		if (node.right == 0) {
+			node.bounds = sphereBox(this->worldBounds[this->order[node.first]]);
+			for (uint32_t j = node.first + 1; j < node.first + node.count; j++) {
+				node.bounds = join(node.bounds, sphereBox(this->worldBounds[this->order[j]]));
+			}
+		} else {
+			node.bounds = join(this->nodes[i + 1].bounds, this->nodes[node.right].bounds);
+		}
+	}
+}
+
+void InstanceBvh::update(const std::vector<InstanceRef3D>& instances) {
+	bool rebuild = this->versions.size() != instances.size();
+	if (rebuild) {
+		this->versions.assign(instances.size(), {0, 0});
+		this->worldBounds.resize(instances.size());
+	}
+
+	bool moved = false;
+	for (size_t i = 0; i < instances.size(); i++) {
+		std::pair current{instances[i].getVersion(), instances[i].getObject().getVersion()};
+		if (this->versions[i] == current) continue;
+		this->worldBounds[i] =
+		    transformSphere(instances[i].getBoundingSphere(), instances[i].fromObjectSpace());
+		this->versions[i] = current;
+		moved = true;
+	}
+	if (not moved and not rebuild) return;
+
+	real area = 0;
+	if (not rebuild) {
+		this->refit();
+		for (const Node& node : this->nodes) area += surfaceArea(node.bounds);
+		// Refitting never changes how instances are split up, so once things have moved far
+		// enough that the boxes are a lot bigger than a fresh tree's, start over.
+		if (area <= 2 * this->builtArea) return;
+	}
+
+	this->order.resize(instances.size());
+	std::iota(ALL_OF(this->order), 0);
+	this->nodes.clear();
+	if (instances.empty()) return;
+	this->build(0, instances.size());
+	this->refit();
+	this->builtArea = 0;
+	for (const Node& node : this->nodes) this->builtArea += surfaceArea(node.bounds);
+}
+
+void InstanceBvh::cull(const std::vector<Plane>& planes, std::vector<uint32_t>& out) const {
+	if (this->nodes.empty()) return;
+	assertLtEq(planes.size(), size_t{32}, "Too many planes to cull against.");
+
+	// nodes left to look at, each with the planes it might still be crossing (parents fully
+	// inside a plane don't need their children tested against it)
+	std::pair<uint32_t, uint32_t> stack[BVH_MAX_DEPTH];
+	int depth = 0;
+	stack[depth++] = {0, planes.size() == 32 ? ~0u : (1u << planes.size()) - 1};
+	while (depth > 0) {
+		auto [index, crossing] = stack[--depth];
+		const Node& node = this->nodes[index];
+		rvec3 center = (node.bounds.min + node.bounds.max) / static_cast<real>(2);
+		rvec3 extent = (node.bounds.max - node.bounds.min) / static_cast<real>(2);
+
+		bool outside = false;
+		for (uint32_t bits = crossing; bits != 0 and not outside; bits &= bits - 1) {
+			const Plane& plane = planes[std::countr_zero(bits)];
+			real distance = signedDistance(plane, center);
+			real reach = glm::dot(glm::abs(plane.normal), extent); // furthest a corner gets
+			real slack = CULL_SLACK * (std::abs(distance) + reach + 1);
+			if (distance + reach < -slack) outside = true;
+			else if (distance - reach > slack) crossing &= ~(bits & -bits);
+		}
+		if (outside) continue;
+
+		if (crossing == 0 or node.right == 0) {
+			out.insert(out.end(), this->order.begin() + node.first,
+			           this->order.begin() + node.first + node.count);
+			continue;
+		}
+		assertLt(depth + 1, BVH_MAX_DEPTH, "BVH is too deep.");
+		stack[depth++] = {node.right, crossing};
+		stack[depth++] = {index + 1, crossing};
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef INSTANCEBVH_HPP
+#define INSTANCEBVH_HPP
+#include "../extraAssertions.hpp"
+#include "precision.hpp"
+#include "renderable.hpp"
+#include "structures.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// most instances a leaf holds
+constexpr uint32_t BVH_LEAF_SIZE = 4;
+
+// A bounding volume hierarchy over the scene's instances, by their bounding spheres in world
+// space, for throwing out everything outside the camera's view a subtree at a time.
+// Instances moving only refits the boxes. The tree is rebuilt when instances are added or
+// removed, or once refitting has let it get too loose to cull well.
+class InstanceBvh {
+  private:
+	// Every node covers a range of order. Children come after their parent: the left one right
+	// after it, the right one at right.
+	struct Node {
+		BoundingBox bounds;
+		uint32_t first;
+		uint32_t count;
+		uint32_t right; // 0 for leaves (the root is never a right child)
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> order; // instance indices, grouped by leaf
+	std::vector<Sphere> worldBounds; // by instance
+	// every instance's version, and its object's, when its bounds were last found
+	std::vector<std::pair<uint64_t, uint64_t>> versions;
+	real builtArea = 0; // surface area of the root right after building
+
+	uint32_t build(const uint32_t first, const uint32_t count);
+	void refit();
+
+  public:
+	// Brings the tree up to date with instances, rebuilding or refitting as needed.
+	void update(const std::vector<InstanceRef3D>& instances);
+
+	// Appends the index of every instance whose bounds might be inside all of planes (in world
+	// space) to out, in no particular order. Only throws out what's clearly outside; anything
+	// close is left for the caller to test exactly.
+	void cull(const std::vector<Plane>& planes, std::vector<uint32_t>& out) const;
+};
+
+#endif /* INSTANCEBVH_HPP */
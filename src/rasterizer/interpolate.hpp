@@ -1,38 +1,175 @@
 #ifndef INTERPOLATE_HPP
 #define INTERPOLATE_HPP
 #include "../extraAssertions.hpp"
-#include <vector>
 
-inline std::vector<double> interpolate(const int x0, const double y0, const int x1,
-                                       const double y1) {
-	// TODO: do these really need to be doubles?
-	if (x0 == x1) // for only one point
-		return {y0};
+#include <glm/ext/vector_int2.hpp>
 
-	assertGt(x1, x0, "Can't interpolate backwards.");
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 
-	std::vector<double> out;
-	out.reserve(x1 - x0 + 1);
+// None of these allocate; values are worked out as they're asked for.
 
-	double slope = (double)(y1 - y0) / (x1 - x0);
-	double y = y0;
-	for (int x = x0; x <= x1; x++) {
-		out.push_back(y);
-		y += slope;
+// Steps y linearly from y0 (at x0) to y1 (at x1), one x at a time.
+// Use it like a range:
+//     for (double y : Interpolator(x0, y0, x1, y1)) ...
+// yields x1 - x0 + 1 values
+class Interpolator {
+  private:
+	double y0;
+	double slope;
+	int count;
+
+  public:
+	struct Sentinel {};
+
+	class Iterator {
+	  private:
+		double y;
+		double slope;
+		int remaining;
+
+	  public:
+		Iterator(const double y, const double slope, const int remaining)
+		    : y(y), slope(slope), remaining(remaining) {}
+
+		double operator*() const { return this->y; }
+
+		Iterator& operator++() {
+			this->y += this->slope;
+			this->remaining--;
+			return *this;
+		}
+
+		bool operator==(const Sentinel&) const { return this->remaining == 0; }
+
+		bool operator!=(const Sentinel&) const { return this->remaining != 0; }
+	};
+
+	// assumes x0 <= x1
+	Interpolator(const int x0, const double y0, const int x1, const double y1)
+	    : y0(y0), slope(0), count(x1 - x0 + 1) {
+		// TODO: do these really need to be doubles?
+		if (x0 == x1) return; // for only one point
+		assertGt(x1, x0, "Can't interpolate backwards.");
+		this->slope = (y1 - y0) / (x1 - x0);
 	}
 
-	return out; // FIXME: Passing a vector like this is horrendously inefficient. Use an iterator.
-}
+	Iterator begin() const { return Iterator(this->y0, this->slope, this->count); }
+
+	Sentinel end() const { return {}; }
+
+	int size() const { return this->count; }
+};
+
+// Like Interpolator, but steps several fields at once and is advanced by hand.
+// Good for walking triangle edges, where each row needs x, depth, normals, etc.
+template <size_t N> class FieldInterpolator {
+  private:
+	std::array<double, N> from;
+	std::array<double, N> values;
+	std::array<double, N> slopes;
+
+  public:
+	// each field goes from from[i] at x0 to to[i] at x1
+	// assumes x0 <= x1
+	FieldInterpolator(const int x0, const std::array<double, N>& from, const int x1,
+	                  const std::array<double, N>& to)
+	    : from(from), values(from), slopes{} {
+		if (x0 == x1) return; // for only one point
+		assertGt(x1, x0, "Can't interpolate backwards.");
+		for (size_t i = 0; i < N; i++) {
+			this->slopes[i] = (to[i] - from[i]) / (x1 - x0);
+		}
+	}
+
+	double operator[](const size_t field) const { return this->values[field]; }
+
+	const std::array<double, N>& get() const { return this->values; }
+
+	// move to the next x
+	void step() {
+		for (size_t i = 0; i < N; i++) {
+			this->values[i] += this->slopes[i];
+		}
+	}
+
+	// Jump to offset xs past x0. Computed from the start rather than stepped, so the values after
+	// a seek don't depend on how many steps or seeks came before it.
+	void seek(const int offset) {
+		for (size_t i = 0; i < N; i++) {
+			this->values[i] = this->from[i] + this->slopes[i] * offset;
+		}
+	}
+};
+
+// Digital differential analyzer: every point on the line from p0 to p1, stepping one unit along
+// whichever axis is longer. Both ends are included.
+//     for (glm::ivec2 point : LineDda(p0, p1)) ...
+class LineDda {
+  private:
+	glm::ivec2 p0;
+	double stepX;
+	double stepY;
+	int steps;
 
-// find the interpolated value at x; use for one-offs where you don't need the whole std::vector
+  public:
+	struct Sentinel {};
+
+	class Iterator {
+	  private:
+		double x;
+		double y;
+		double stepX;
+		double stepY;
+		int remaining;
+
+	  public:
+		Iterator(const glm::ivec2 start, const double stepX, const double stepY,
+		         const int remaining)
+		    : x(start.x), y(start.y), stepX(stepX), stepY(stepY), remaining(remaining) {}
+
+		// truncated, like SextantCoord does
+		glm::ivec2 operator*() const { return {static_cast<int>(x), static_cast<int>(y)}; }
+
+		Iterator& operator++() {
+			this->x += this->stepX;
+			this->y += this->stepY;
+			this->remaining--;
+			return *this;
+		}
+
+		bool operator==(const Sentinel&) const { return this->remaining == 0; }
+
+		bool operator!=(const Sentinel&) const { return this->remaining != 0; }
+	};
+
+	LineDda(const glm::ivec2 p0, const glm::ivec2 p1) : p0(p0), stepX(0), stepY(0) {
+		int dx = p1.x - p0.x;
+		int dy = p1.y - p0.y;
+		int length = std::max(std::abs(dx), std::abs(dy));
+		this->steps = length + 1;
+		if (length == 0) return; // for only one point
+		this->stepX = static_cast<double>(dx) / length;
+		this->stepY = static_cast<double>(dy) / length;
+	}
+
+	Iterator begin() const {
+		return Iterator(this->p0, this->stepX, this->stepY, this->steps);
+	}
+
+	Sentinel end() const { return {}; }
+};
+
+// find the interpolated value at x; use for one-offs where you don't need to step along the line
 inline double interpolateValue(const int x0, const double y0, const int x1, const double y1,
                                const int x) {
 	assertGt(x1, x0, "Can't interpolate backwards");
 	double slope = (double)(y1 - y0) / (x1 - x0);
-	return y0 + (x - x1) * slope;
+	return y0 + (x - x0) * slope;
 }
 
-// find the interpolated value at t; use for one-offs where you don't need the whole std::vector
+// find the interpolated value at t; use for one-offs where you don't need to step along the line
 // instead of using x, this function uses t. t describes where the value is, and varies from 0 to 1
 // across the interpolated segment
 inline double interpolateValue(const double y0, const double y1, const double t) {
@@ -40,28 +177,4 @@ inline double interpolateValue(const double y0, const double y1, const double t)
 	return y0 + t * (y1 - y0);
 }
 
-// interpolate a member of Elem
-template <typename Elem>
-inline void interpolateField(std::vector<Elem>& baseVector, double Elem::* member, const int x0,
-                             const double y0, const int x1, const double y1) {
-	// TODO: do these really need to be doubles?
-
-	assertEq(baseVector.size(), static_cast<uint>(x1 - x0 + 1),
-	         "baseVector must be set to the correct size beforehand.");
-
-	if (x0 == x1) { // for only one point
-		baseVector[0].*member = y0;
-		return;
-	}
-
-	assertGt(x1, x0, "Can't interpolate backwards");
-
-	double slope = (double)(y1 - y0) / (x1 - x0);
-	double y = y0;
-	for (int x = 0; x <= x1 - x0; x++) {
-		baseVector[x].*member = y;
-		y += slope;
-	}
-}
-
 #endif /* INTERPOLATE_HPP */
@@ -0,0 +1,119 @@
+#ifndef LANES_HPP
+#define LANES_HPP
+#include "precision.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(PLAY3D_SIMD) and defined(__AVX2__)
+	#include <immintrin.h>
+	#define LANES_AVX2
+#endif
+
+// Kernels are written once against Lanes, which is either an AVX2 register (four doubles, or
+// eight floats in single precision builds) or a single real. Masks are Lanes too: all bits set
+// (or 1) where true, 0 where false.
+// load and store need 32 byte alignment, the unaligned versions don't.
+#ifdef LANES_AVX2
+	#ifdef PLAY3D_SINGLE_PRECISION
+		#define AVX(op) _mm256_##op##_ps
+	#else
+		#define AVX(op) _mm256_##op##_pd
+	#endif
+
+struct Lanes {
+	#ifdef PLAY3D_SINGLE_PRECISION
+	typedef __m256 Register;
+	#else
+	typedef __m256d Register;
+	#endif
+
+	static constexpr int width = sizeof(Register) / sizeof(real);
+	Register v;
+
+	static Lanes load(const real* from) { return {AVX(load)(from)}; }
+
+	static Lanes loadUnaligned(const real* from) { return {AVX(loadu)(from)}; }
+
+	static Lanes fill(const real value) { return {AVX(set1)(value)}; }
+
+	void store(real* to) const { AVX(store)(to, this->v); }
+
+	void storeUnaligned(real* to) const { AVX(storeu)(to, this->v); }
+};
+
+inline Lanes operator+(const Lanes a, const Lanes b) { return {AVX(add)(a.v, b.v)}; }
+
+inline Lanes operator-(const Lanes a, const Lanes b) { return {AVX(sub)(a.v, b.v)}; }
+
+inline Lanes operator*(const Lanes a, const Lanes b) { return {AVX(mul)(a.v, b.v)}; }
+
+inline Lanes operator/(const Lanes a, const Lanes b) { return {AVX(div)(a.v, b.v)}; }
+
+inline Lanes sqrt(const Lanes a) { return {AVX(sqrt)(a.v)}; }
+
+inline Lanes min(const Lanes a, const Lanes b) { return {AVX(min)(a.v, b.v)}; }
+
+inline Lanes max(const Lanes a, const Lanes b) { return {AVX(max)(a.v, b.v)}; }
+
+inline Lanes greater(const Lanes a, const Lanes b) { return {AVX(cmp)(a.v, b.v, _CMP_GT_OQ)}; }
+
+inline Lanes notEqual(const Lanes a, const Lanes b) { return {AVX(cmp)(a.v, b.v, _CMP_NEQ_OQ)}; }
+
+inline Lanes both(const Lanes a, const Lanes b) { return {AVX(and)(a.v, b.v)}; }
+
+// mask ? a : b, lane by lane
+inline Lanes select(const Lanes mask, const Lanes a, const Lanes b) {
+	return {AVX(blendv)(b.v, a.v, mask.v)};
+}
+
+// bit i is set if lane i of the mask is
+inline int maskBits(const Lanes mask) { return AVX(movemask)(mask.v); }
+
+	#undef AVX
+#else
+struct Lanes {
+	static constexpr int width = 1;
+	real v;
+
+	static Lanes load(const real* from) { return {*from}; }
+
+	static Lanes loadUnaligned(const real* from) { return {*from}; }
+
+	static Lanes fill(const real value) { return {value}; }
+
+	void store(real* to) const { *to = this->v; }
+
+	void storeUnaligned(real* to) const { *to = this->v; }
+};
+
+inline Lanes operator+(const Lanes a, const Lanes b) { return {a.v + b.v}; }
+
+inline Lanes operator-(const Lanes a, const Lanes b) { return {a.v - b.v}; }
+
+inline Lanes operator*(const Lanes a, const Lanes b) { return {a.v * b.v}; }
+
+inline Lanes operator/(const Lanes a, const Lanes b) { return {a.v / b.v}; }
+
+inline Lanes sqrt(const Lanes a) { return {std::sqrt(a.v)}; }
+
+inline Lanes min(const Lanes a, const Lanes b) { return {std::min(a.v, b.v)}; }
+
+inline Lanes max(const Lanes a, const Lanes b) { return {std::max(a.v, b.v)}; }
+
+inline Lanes greater(const Lanes a, const Lanes b) { return {static_cast<real>(a.v > b.v)}; }
+
+inline Lanes notEqual(const Lanes a, const Lanes b) { return {static_cast<real>(a.v != b.v)}; }
+
+inline Lanes both(const Lanes a, const Lanes b) {
+	return {static_cast<real>(a.v != 0 and b.v != 0)};
+}
+
+inline Lanes select(const Lanes mask, const Lanes a, const Lanes b) {
+	return mask.v != 0 ? a : b;
+}
+
+inline int maskBits(const Lanes mask) { return mask.v != 0; }
+#endif
+
+#endif /* LANES_HPP */
@@ -0,0 +1,111 @@
+#include "lightGrid.hpp"
+
+#include "renderable.hpp"
+#include "triangles.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+// Lights are culled as if their range were this much bigger, so rounding (in where fragments are
+// reconstructed, and in moving lights to object space) can't cull a light that still reaches.
+constexpr real RANGE_MARGIN = 1.01;
+
+int LightGrid::slice(const real distance) const {
+	if (not(distance > this->nearest)) return 0; // also catches NaN
+	if (distance >= this->furthest) return LIGHT_SLICES - 1;
+	int slice = static_cast<int>(std::log(distance / this->nearest) * this->sliceScale);
+	return std::min(slice, LIGHT_SLICES - 1);
+}
+
+void LightGrid::build(const LightTable& lights, const Camera& camera, const ivec2 canvasSize) {
+	bool anyRange = std::ranges::any_of(lights.range, [](real range) {
+		return not std::isinf(range);
+	});
+	// ranges are only distances in camera space if it isn't stretched
+	this->active = anyRange and lights.uniformFade and lights.size() <= MAX_CULLED_LIGHTS;
+	if (not this->active) return;
+
+	this->tilesHigh = (canvasSize.y + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	this->tilesWide = (canvasSize.x + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	this->words = (lights.size() + 63) / 64;
+	this->masks.assign(static_cast<size_t>(this->tilesHigh) * this->tilesWide * LIGHT_SLICES
+	                       * this->words,
+	                   0);
+
+	// Nothing drawn is nearer than the viewport, and past every light's reach only the ones
+	// without a range matter (which are everywhere anyways).
+	this->nearest = camera.viewportDistance;
+	this->furthest = this->nearest * 2; // so there's always some depth to split up
+	for (size_t light = 0; light < lights.size(); light++) {
+		if (std::isinf(lights.range[light])) continue;
+		rvec3 position{lights.x[light], lights.y[light], lights.z[light]};
+		this->furthest = std::max(this->furthest,
+		                          glm::length(position) + lights.range[light] * RANGE_MARGIN);
+	}
+	this->sliceScale = LIGHT_SLICES / std::log(this->furthest / this->nearest);
+
+	for (size_t light = 0; light < lights.size(); light++) {
+		int minTileRow = 0, maxTileRow = this->tilesHigh - 1;
+		int minTileCol = 0, maxTileCol = this->tilesWide - 1;
+		int minSlice = 0, maxSlice = LIGHT_SLICES - 1;
+
+		if (not std::isinf(lights.range[light])) {
+			rvec3 position{lights.x[light], lights.y[light], lights.z[light]};
+			Sphere reach{position, lights.range[light] * RANGE_MARGIN};
+			real distance = glm::length(reach.center);
+			minSlice = this->slice(distance - reach.radius);
+			maxSlice = this->slice(distance + reach.radius);
+
+			// if it reaches the viewport, it could be lighting any tile
+			ScreenRect rect;
+			if (sphereBounds(reach, camera, canvasSize, rect)) {
+				if (rect.maxRow < 0 or rect.minRow >= canvasSize.y or rect.maxCol < 0
+				    or rect.minCol >= canvasSize.x)
+					continue; // completely off the canvas
+				minTileRow = std::max(rect.minRow, 0) / LIGHT_TILE_SIZE;
+				maxTileRow = std::min(rect.maxRow, canvasSize.y - 1) / LIGHT_TILE_SIZE;
+				minTileCol = std::max(rect.minCol, 0) / LIGHT_TILE_SIZE;
+				maxTileCol = std::min(rect.maxCol, canvasSize.x - 1) / LIGHT_TILE_SIZE;
+			}
+		}
+
+		uint64_t bit = uint64_t{1} << (light % 64);
+		for (int tileRow = minTileRow; tileRow <= maxTileRow; tileRow++) {
+			for (int tileCol = minTileCol; tileCol <= maxTileCol; tileCol++) {
+				for (int slice = minSlice; slice <= maxSlice; slice++) {
+					this->masks[this->clusterIndex(tileRow, tileCol, slice) + light / 64] |= bit;
+				}
+			}
+		}
+	}
+}
+
+void LightGrid::gather(const int* rows, const int* cols, const real* invDepths, const int count,
+                       LightMask& out) const {
+	assertMsg(this->active, "Can't gather lights from an inactive grid.");
+	std::fill_n(out.words, this->words, 0);
+
+	size_t previous = std::numeric_limits<size_t>::max();
+	for (int i = 0; i < count; i++) {
+		assertBetweenHalfOpen(0, rows[i] / LIGHT_TILE_SIZE, this->tilesHigh, "Row out of bounds.");
+		assertBetweenHalfOpen(0, cols[i] / LIGHT_TILE_SIZE, this->tilesWide, "Col out of bounds.");
+		size_t cluster = this->clusterIndex(rows[i] / LIGHT_TILE_SIZE, cols[i] / LIGHT_TILE_SIZE,
+		                                    this->slice(1 / invDepths[i]));
+		if (cluster == previous) continue; // neighbors are usually in the same one
+		previous = cluster;
+		for (size_t word = 0; word < this->words; word++) {
+			out.words[word] |= this->masks[cluster + word];
+		}
+	}
+}
+
+real LightGrid::averageLights() const {
+	if (not this->active or this->masks.empty()) return 0;
+	size_t total = 0;
+	for (uint64_t word : this->masks) total += std::popcount(word);
+	return static_cast<real>(total) / (this->masks.size() / this->words);
+}
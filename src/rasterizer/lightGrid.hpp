@@ -0,0 +1,59 @@
+#ifndef LIGHTGRID_HPP
+#define LIGHTGRID_HPP
+#include "../extraAssertions.hpp"
+#include "lightTable.hpp"
+#include "precision.hpp"
+#include "structures.hpp"
+
+#include <glm/ext/vector_int2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// sextants across (and down) a light culling tile
+constexpr int LIGHT_TILE_SIZE = 16;
+// how many ranges of distance from the camera each tile is split into
+constexpr int LIGHT_SLICES = 16;
+
+// Which lights can reach each cluster of the view: a LIGHT_TILE_SIZE square of sextants, over one
+// slice of distances from the camera. Slices get exponentially deeper further out, from the
+// viewport to the far side of the furthest light with a range.
+// Lights without a range are in every cluster. Clusters only ever have extra lights, never
+// missing ones, so shading with a cluster's lights gives exactly what all of them would.
+class LightGrid {
+  private:
+	bool active = false;
+	int tilesHigh = 0;
+	int tilesWide = 0;
+	real nearest = 1; // where the first slice starts
+	real furthest = 2; // where the last one ends
+	real sliceScale = 0; // a distance's slice is log(distance / nearest) * sliceScale
+	size_t words = 0; // in each cluster's mask
+	std::vector<uint64_t> masks; // every cluster's, by tile row, then tile column, then slice
+
+	[[nodiscard]] int slice(const real distance) const;
+
+	[[nodiscard]] size_t clusterIndex(const int tileRow, const int tileCol, const int slice) const {
+		return ((static_cast<size_t>(tileRow) * this->tilesWide + tileCol) * LIGHT_SLICES + slice)
+		       * this->words;
+	}
+
+  public:
+	// Sorts lights (in camera space) into the clusters of a canvasSize canvas. Only bothers if
+	// culling could help: some light has to have a range, and there can't be more than
+	// MAX_CULLED_LIGHTS of them. Keeps its memory between calls.
+	void build(const LightTable& lights, const Camera& camera, const ivec2 canvasSize);
+
+	// whether the last build did anything; if not, everything should be lit by every light
+	[[nodiscard]] bool isActive() const { return this->active; }
+
+	// Fills out with every light that can reach any of the fragments, which are by canvas row and
+	// column, with the inverse distance from the camera (as in the depth buffer).
+	void gather(const int* rows, const int* cols, const real* invDepths, const int count,
+	            LightMask& out) const;
+
+	// the average number of lights in a cluster, for benchmarks
+	[[nodiscard]] real averageLights() const;
+};
+
+#endif /* LIGHTGRID_HPP */
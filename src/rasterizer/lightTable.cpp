@@ -0,0 +1,120 @@
+#include "lightTable.hpp"
+
+#include "shadowMaps.hpp"
+#include "structures.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <print>
+
+void LightTable::clear() {
+	this->x.clear();
+	this->y.clear();
+	this->z.clear();
+	this->pointWeight.clear();
+	this->intensity.clear();
+	this->range.clear();
+	this->invRangeSquared.clear();
+	this->shadows = NULL;
+	this->toWorld = rmat4{1};
+	this->fadeSpace = rmat3{1};
+	this->uniformFade = true;
+}
+
+void LightTable::reserve(const size_t size) {
+	this->x.reserve(size);
+	this->y.reserve(size);
+	this->z.reserve(size);
+	this->pointWeight.reserve(size);
+	this->intensity.reserve(size);
+	this->range.reserve(size);
+	this->invRangeSquared.reserve(size);
+}
+
+void LightTable::pushRange(const real range) {
+	this->range.push_back(range);
+	this->invRangeSquared.push_back(std::isinf(range) ? 0 : 1 / (range * range));
+}
+
+// whether matrix only rotates, and scales the same along every axis (give or take rounding)
+static bool uniformlyScaled(const rmat3& matrix) {
+	real lengths[3]{glm::dot(matrix[0], matrix[0]), glm::dot(matrix[1], matrix[1]),
+	                glm::dot(matrix[2], matrix[2])};
+	real tolerance = 1e-5 * std::max({lengths[0], lengths[1], lengths[2]});
+	return std::abs(lengths[0] - lengths[1]) <= tolerance
+	   and std::abs(lengths[0] - lengths[2]) <= tolerance
+	   and std::abs(glm::dot(matrix[0], matrix[1])) <= tolerance
+	   and std::abs(glm::dot(matrix[0], matrix[2])) <= tolerance
+	   and std::abs(glm::dot(matrix[1], matrix[2])) <= tolerance;
+}
+
+void LightTable::assign(const std::span<const std::shared_ptr<Light>> lights) {
+	this->clear();
+	this->reserve(lights.size());
+
+	for (const std::shared_ptr<Light>& light : lights) {
+		// the direction from the origin is the position for point lights, and just the direction
+		// for directional ones
+		rvec3 vector = light->getDirection(origin);
+		this->x.push_back(vector.x);
+		this->y.push_back(vector.y);
+		this->z.push_back(vector.z);
+		this->pointWeight.push_back(light->getType() == LightType::Point ? 1 : 0);
+		this->intensity.push_back(light->getIntensity());
+		this->pushRange(light->getRange());
+	}
+}
+
+void LightTable::assignTransformed(const LightTable& from, const rmat4& matrix) {
+	assertMsg(&from != this, "Can't transform a light table into itself.");
+	this->clear();
+	this->reserve(from.size());
+	this->shadows = from.shadows;
+	if (this->shadows != NULL) this->toWorld = from.toWorld * glm::affineInverse(matrix);
+
+	// Ranges scale with everything else when that's the same along every axis. Otherwise they
+	// stay as they are, and fadeSpace takes distances back to where they were measured.
+	rmat3 linear{matrix};
+	real scale = 1;
+	if (from.uniformFade and uniformlyScaled(linear)) {
+		scale = glm::length(linear[0]);
+	} else {
+		rmat3 fadeSpace = from.fadeSpace * glm::inverse(linear);
+		if (uniformlyScaled(fadeSpace)) {
+			scale = 1 / glm::length(fadeSpace[0]);
+		} else {
+			this->fadeSpace = fadeSpace;
+			this->uniformFade = false;
+		}
+	}
+	for (size_t light = 0; light < from.size(); light++) {
+		rvec3 vector{from.x[light], from.y[light], from.z[light]};
+		rvec3 moved;
+		if (from.isPoint(light)) {
+			moved = canonicalize(matrix * toHomogenous(vector));
+			if (debugFrame)
+				std::println(std::cerr, "Point light at {} translated to {}.", vector, moved);
+		} else {
+			moved = partialDecompose(matrix).rotation * vector;
+			if (debugFrame)
+				std::println(std::cerr, "Directional light from {} rotated to {}", vector, moved);
+		}
+
+		this->x.push_back(moved.x);
+		this->y.push_back(moved.y);
+		this->z.push_back(moved.z);
+		this->pointWeight.push_back(from.pointWeight[light]);
+		this->intensity.push_back(from.intensity[light]);
+		this->pushRange(from.range[light] * scale);
+	}
+}
+
+real LightTable::visibility(const size_t light, const rvec3 point) const {
+	if (this->shadows == NULL) return 1;
+	return this->shadows->visibility(light, canonicalize(this->toWorld * toHomogenous(point)));
+}
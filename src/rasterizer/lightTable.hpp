@@ -0,0 +1,101 @@
+#ifndef LIGHTTABLE_HPP
+#define LIGHTTABLE_HPP
+#include "../extraAssertions.hpp"
+#include "precision.hpp"
+#include "renderable.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+class ShadowMaps;
+
+// light culling only handles this many lights; past it, everything is lit by every light
+constexpr size_t MAX_CULLED_LIGHTS = 1024;
+
+// Which of a LightTable's lights to use: bit i (of words[i / 64]) for light i.
+// Only the words covering the table's lights are ever read.
+struct LightMask {
+	uint64_t words[MAX_CULLED_LIGHTS / 64];
+};
+
+// The scene's lights, flattened into arrays so shading never makes virtual calls or touches a
+// shared_ptr. Lights keep the order they were added in.
+// Every light's direction (towards the light) is vector - point * pointWeight: point lights have
+// their position and a weight of 1, directional lights their direction and a weight of 0.
+struct LightTable {
+	std::vector<real> x;
+	std::vector<real> y;
+	std::vector<real> z;
+	std::vector<real> pointWeight;
+	std::vector<real> intensity;
+	std::vector<real> range; // infinite for lights that don't fade
+	// 1 / range^2, so 0 for lights that don't fade; what shading actually uses
+	std::vector<real> invRangeSquared;
+	// Ranges are distances in the world, so in a space that's scaled differently along each axis
+	// (like an object's), distances to lights have to be taken back through fadeSpace before
+	// they're compared to them. Uniform scaling is folded into range instead, leaving fadeSpace
+	// the identity and uniformFade set.
+	rmat3 fadeSpace{1};
+	bool uniformFade = true;
+	// Where shadows come from, if there are any, and how to get from this table's space to the
+	// world's to look them up in. assign leaves these unset, and assignTransformed copies them.
+	const ShadowMaps* shadows = NULL;
+	rmat4 toWorld{1};
+
+	// Replaces what's there with lights (usually Scene::lights), keeping the vectors' capacity.
+	void assign(const std::span<const std::shared_ptr<Light>> lights);
+
+	// Replaces what's there with from's lights moved by matrix, keeping the vectors' capacity.
+	// from can't be this table.
+	void assignTransformed(const LightTable& from, const rmat4& matrix);
+
+	[[nodiscard]] size_t size() const { return this->intensity.size(); }
+
+	[[nodiscard]] bool isPoint(const size_t light) const { return this->pointWeight[light] != 0; }
+
+	// towards the light, from point; not normalized
+	[[nodiscard]] rvec3 getDirection(const size_t light, const rvec3 point) const {
+		return rvec3{this->x[light], this->y[light], this->z[light]}
+		       - point * this->pointWeight[light];
+	}
+
+	// How much of the light's intensity is left at toLight (from getDirection) away. Exactly 1
+	// for lights that don't fade.
+	[[nodiscard]] real attenuation(const size_t light, const rvec3 toLight) const {
+		rvec3 measured = this->uniformFade ? toLight : this->fadeSpace * toLight;
+		real fade = std::max<real>(
+		    0, 1 - (measured.x * measured.x + measured.y * measured.y + measured.z * measured.z)
+		               * this->invRangeSquared[light]);
+		return fade * fade;
+	}
+
+	// 1 if the light reaches point, or 0 if its shadow map says something's in the way. Always 1
+	// without shadows.
+	[[nodiscard]] real visibility(const size_t light, const rvec3 point) const;
+
+	// Calls function(light) for every light in mask, in order, or every light if mask is NULL.
+	template <typename Function> void forEach(const LightMask* mask, Function function) const {
+		if (mask == NULL) {
+			for (size_t light = 0; light < this->size(); light++) function(light);
+			return;
+		}
+
+		assertLtEq(this->size(), MAX_CULLED_LIGHTS, "Too many lights to cull.");
+		for (size_t word = 0; word < (this->size() + 63) / 64; word++) {
+			for (uint64_t bits = mask->words[word]; bits != 0; bits &= bits - 1) {
+				function(word * 64 + std::countr_zero(bits));
+			}
+		}
+	}
+
+  private:
+	void clear();
+	void reserve(const size_t size);
+	void pushRange(const real range); // and its invRangeSquared
+};
+
+#endif /* LIGHTTABLE_HPP */
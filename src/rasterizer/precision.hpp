@@ -0,0 +1,34 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include <glm/ext/matrix_float3x3.hpp>
+#include <glm/ext/matrix_float3x4.hpp>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/matrix_double3x3.hpp>
+#include <glm/ext/matrix_double3x4.hpp>
+#include <glm/ext/matrix_double4x4.hpp>
+#include <glm/ext/vector_float2.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/vector_double2.hpp>
+#include <glm/ext/vector_double3.hpp>
+#include <glm/ext/vector_double4.hpp>
+
+// The rasterizer's scalar type, used for all of its geometry and shading.
+// Doubles by default; build with PLAY3D_SINGLE_PRECISION (a CMake option) for floats, which fit
+// twice as many to a SIMD register and halve the memory traffic.
+// The depth buffer is always float, and edge walking always double.
+#ifdef PLAY3D_SINGLE_PRECISION
+typedef float real;
+#else
+typedef double real;
+#endif
+
+typedef glm::vec<2, real> rvec2;
+typedef glm::vec<3, real> rvec3;
+typedef glm::vec<4, real> rvec4;
+typedef glm::mat<3, 3, real> rmat3;
+typedef glm::mat<3, 4, real> rmat3x4;
+typedef glm::mat<4, 4, real> rmat4;
+
+#endif /* PRECISION_HPP */
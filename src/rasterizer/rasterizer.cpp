@@ -1,15 +1,20 @@
 #include "rasterizer.hpp"
 
+#include "binning.hpp"
+#include "deferred.hpp"
+#include "depthBuffer.hpp"
+#include "renderContext.hpp"
 #include "renderable.hpp"
 #include "scene.hpp"
 #include "structures.hpp"
+#include "tiledTriangles.hpp"
 #include "triangles.hpp"
+#include "vertexKernel.hpp"
 #include "../util/floatComparisons.hpp"
+#include "../util/threadPool.hpp"
 
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/quaternion_geometric.hpp>
-#include <glm/ext/vector_double3.hpp>
-#include <glm/ext/vector_double4.hpp>
 #include <glm/ext/vector_int2.hpp>
 #include <glm/geometric.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -21,86 +26,252 @@
 
 #include <__ostream/print.h>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <memory>
+#include <numeric>
 #include <ranges>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-std::vector<std::shared_ptr<Light>>
-translateLights(const std::vector<std::shared_ptr<Light>>& lights, const dmat4 translation) {
-	std::vector<std::shared_ptr<Light>> out;
-	out.reserve(lights.size());
-
-	for (const std::shared_ptr<const Light> light : lights) {
-		auto asPoint = dynamic_pointer_cast<const PointLight>(light);
-		if (asPoint != NULL) {
-			dvec3 position = asPoint->getPosition();
-			dvec4 homogenous = toHomogenous(position);
-			dvec3 newPoint = canonicalize(translation * homogenous);
-
-			out.push_back(
-			    std::make_shared<PointLight>(PointLight{asPoint->getIntensity(), newPoint}));
-			if (debugFrame)
-				std::println(std::cerr, "Point light at {} translated to {}.", position, newPoint);
-		} else {
-			auto asDirectional = dynamic_pointer_cast<const DirectionalLight>(light);
-			assertMsg(asDirectional != NULL, "WTF is this light?!");
-			dvec3 newDir = partialDecompose(translation).rotation * asDirectional->getDirection();
-
-			out.push_back(std::make_shared<DirectionalLight>(
-			    DirectionalLight{asDirectional->getIntensity(), newDir}));
-			if (debugFrame)
-				std::println(std::cerr, "Directional light from {} rotated to {}",
-				             asDirectional->getDirection(), newDir);
-		}
+// how much bigger an instance has to get than where a level of detail switches in to switch back
+constexpr real LOD_HYSTERESIS = 1.25;
+
+// about how many points each of the pool's jobs transforms, so small instances get batched
+constexpr size_t TRANSFORM_JOB_POINTS = 2048;
+
+// Boxes only settle which side of a plane they're on when they're clearly past it (relative to
+// their size and distance), so rounding differently from the vertex kernel can't matter.
+constexpr real BOX_SLACK = 1e-4;
+
+// the instance's bounding sphere, in camera space
+static Sphere camSpaceBoundingSphere(const Camera& camera, const InstanceRef3D& objectInst) {
+	return transformSphere(objectInst.getBoundingSphere(),
+	                       camera.toCameraSpace() * objectInst.fromObjectSpace());
+}
+
+// box (around the instance's mesh, in object space) in camera space
+static OrientedBox camSpaceBox(const Camera& camera, const InstanceRef3D& objectInst,
+                               const BoundingBox& box) {
+	return transformBox(box, camera.toCameraSpace() * objectInst.fromObjectSpace());
+}
+
+// Which side of the plane everything in the box is on. Crossing unless it's clearly one side.
+static PlaneSide boxSide(const OrientedBox& box, const Plane& plane) {
+	real distance = signedDistance(plane, box.center);
+	real reach = boxReach(box, plane);
+	real slack = BOX_SLACK * (std::abs(distance) + reach + 1);
+	if (distance + reach < -slack) return PlaneSide::Outside;
+	if (distance - reach > slack) return PlaneSide::Inside;
+	return PlaneSide::Crossing;
+}
+
+// the mesh the instance is drawn with, at the level of detail picked for it this frame
+static const Object3D& drawnObject(const RenderContext& context, const Scene& scene,
+                                   const InstanceRef3D& objectInst) {
+	return objectInst.getObject().getLod(context.lodLevels[&objectInst - scene.instances.data()]);
+}
+
+// Picks the level of detail for an instance with bounds (in camera space), given the one it had
+// last frame. Levels get coarser as soon as it's small enough, but only get finer again once
+// it's LOD_HYSTERESIS times bigger than that.
+static uint pickLod(const Object3D& object, const Sphere& bounds, const Camera& camera,
+                    const ivec2 canvasSize, const uint previous) {
+	real distance = glm::length(bounds.center);
+	if (distance <= bounds.radius) return 0; // the camera's inside it
+
+	rmat3x4 projection = camera.viewportTransform(canvasSize);
+	real radius = bounds.radius * std::max(projection[0][0], projection[1][1]) / distance;
+	uint level = std::min<uint>(previous, object.getLodCount() - 1);
+	while (level + 1 < object.getLodCount() and radius < object.getLodRadius(level + 1)) level++;
+	while (level > 0 and radius >= object.getLodRadius(level) * LOD_HYSTERESIS) level--;
+	return level;
+}
+
+// whether the cache's points are still right for the instance, drawn with object
+static bool cacheCurrent(const VertexCache& cache, const InstanceRef3D& objectInst,
+                         const Object3D& object, const Camera& camera,
+                         const rmat3x4& projection) {
+	return cache.instanceVersion == objectInst.getVersion()
+	   and cache.objectVersion == object.getVersion()
+	   and cache.cameraVersion == camera.getVersion() and cache.projection == projection;
+}
+
+// whether the sphere is entirely on the outside of one of the planes
+static bool outsideAnyPlane(const Sphere& bounds, const std::vector<Plane>& planes) {
+	return std::ranges::any_of(planes, [&](const Plane& plane) {
+		return signedDistance(plane, bounds.center) <= -bounds.radius;
+	});
+}
+
+// Fills context.candidates with every instance that might be in view, in scene order: the ones
+// the BVH doesn't cull, or all of them without it. Each still needs testing on its own.
+static void findCandidates(RenderContext& context, const Scene& scene) {
+	std::vector<uint32_t>& candidates = context.candidates;
+	candidates.clear();
+	if (not context.settings.instanceBvh) {
+		candidates.resize(scene.instances.size());
+		std::iota(ALL_OF(candidates), 0);
+		return;
 	}
 
-	return out;
+	// a point's distance from a camera space plane is (normal, distance) . (toCam * point, 1),
+	// which is the same thing as a plane in world space
+	const rmat4& toCam = scene.camera.toCameraSpace();
+	context.worldPlanes.clear();
+	for (const Plane& plane : context.clippingPlanes) {
+		context.worldPlanes.push_back({glm::transpose(rmat3{toCam}) * plane.normal,
+		                               glm::dot(plane.normal, rvec3{toCam[3]}) + plane.distance});
+	}
+
+	context.instanceBvh.update(scene.instances);
+	context.instanceBvh.cull(context.worldPlanes, candidates);
+	// so instances that tie when sorted are still drawn in the same order as without the BVH
+	std::sort(ALL_OF(candidates));
 }
 
-static void renderInstance(SextantDrawing& canvas, boost::multi_array<float, 2>& depthBuffer,
-                           const Camera& camera, const InstanceRef3D& objectInst,
-                           const double ambientLight,
-                           const std::vector<std::shared_ptr<Light>> lights) {
-	std::unique_ptr<InstanceSC3D> copied = std::make_unique<InstanceSC3D>(InstanceSC3D{objectInst});
+// transforms one instance's copy of its mesh, then copies it into its cache
+static void transformInstance(VertexStream& stream, const PendingTransform& pending,
+                              const Camera& camera, const rmat3x4& projection) {
+	const InstanceRef3D& objectInst = *pending.instance;
+	VertexCache& cache = *pending.cache;
+	size_t count = pending.object->getPoints().size();
 
-	dmat4 toCam = camera.toCameraSpace() * objectInst.fromObjectSpace();
+	rmat4 toCam = camera.toCameraSpace() * objectInst.fromObjectSpace();
+	transformVertices(stream, pending.source, pending.target, count, toCam, projection);
 
-	// translate to camera space
-	for (uint vertexIdx = 0; vertexIdx < copied->getPoints().size(); vertexIdx++) {
-		dvec3 vertex = copied->getPoint(vertexIdx);
-		dvec4 homogenous = {vertex.x, vertex.y, vertex.z, 1};
-		homogenous = toCam * homogenous;
-		copied->setPoint(vertexIdx, canonicalize(homogenous));
+	cache.points.clear();
+	cache.projected.clear();
+	for (size_t point = pending.target; point < pending.target + count; point++) {
+		cache.points.push_back(stream.getCamera(point));
+		cache.projected.push_back(toSubpixel(rvec2{stream.canvasX[point], stream.canvasY[point]}));
 	}
+	cache.instanceVersion = objectInst.getVersion();
+	cache.objectVersion = pending.object->getVersion();
+	cache.cameraVersion = camera.getVersion();
+	cache.projection = projection;
+}
 
-	std::vector<Plane> clippingPlanes = camera.getClippingPlanes();
-	clipInstance(copied, clippingPlanes);
-	if (copied == NULL) return;
+// Brings every pending instance's cache up to date from context.vertexStream, which has all of
+// their meshes in it. Instances are handed to the pool in runs of about TRANSFORM_JOB_POINTS
+// points, so thousands of tiny ones aren't a job each.
+static void transformPending(RenderContext& context, const Camera& camera,
+                             const rmat3x4& projection) {
+	VertexStream& stream = context.vertexStream;
+	stream.finish();
 
-	// light translated to be in object coordinates, for lighting calculations
-	// lights are inputted in world coordinates
-	std::vector instLights = translateLights(lights, copied->toObjectSpace());
+	std::vector<size_t>& jobs = context.transformJobs; // where each starts, then where all end
+	jobs.clear();
+	size_t jobPoints = TRANSFORM_JOB_POINTS;
+	for (size_t i = 0; i < context.pendingTransforms.size(); i++) {
+		if (jobPoints >= TRANSFORM_JOB_POINTS) {
+			jobs.push_back(i);
+			jobPoints = 0;
+		}
+		jobPoints += context.pendingTransforms[i].object->getPoints().size();
+	}
+	jobs.push_back(context.pendingTransforms.size());
+
+	context.pool.parallelFor(jobs.size() - 1, [&](const size_t job) {
+		for (size_t i = jobs[job]; i < jobs[job + 1]; i++) {
+			transformInstance(stream, context.pendingTransforms[i], camera, projection);
+		}
+	});
+}
 
-	copied = backFaceCulling(std::move(copied));
+// projects the instance's visible triangles into bins; nothing is drawn until they're flushed
+static void renderInstance(RenderContext& context, const ivec2 canvasSize, const Camera& camera,
+                           const InstanceRef3D& objectInst, const Object3D& object,
+                           VertexCache& cache, const real ambientLight,
+                           const LightTable& lights /* in camera space */) {
+	const RenderSettings& settings = context.settings;
 
-	std::vector<ivec2> projected;
-	projected.reserve(copied->getPoints().size());
+	// Sort the planes out with the bounding sphere before touching any vertices. Outside of any
+	// of them means there's nothing to draw, and triangles can't cross a plane the sphere is
+	// fully inside of, so those don't need testing.
+	// The box around the mesh being drawn is tighter, so it gets a say on the planes the sphere
+	// crosses. Every one it settles saves testing each triangle against it.
+	Sphere bounds = camSpaceBoundingSphere(camera, objectInst);
+	OrientedBox box = camSpaceBox(camera, objectInst, object.getBoundingBox());
+	size_t objectTriangles = object.getTriangles().size();
+	std::vector<Plane>& crossedPlanes = context.crossedPlanes;
+	crossedPlanes.clear();
+	for (const Plane& plane : context.clippingPlanes) {
+		real distance = signedDistance(plane, bounds.center);
+		if (distance <= -bounds.radius) return; // fully outside
+		if (distance >= bounds.radius) continue;
 
-	// project the points
-	for (const dvec3& vertex : copied->getPoints()) {
-		// skip missing points
-		if (vertex == NO_POINT) {
-			projected.push_back({0, 0});
-			continue;
+		PlaneSide side = boxSide(box, plane);
+		if (side != PlaneSide::Crossing) context.stats.planeTestsAvoided += objectTriangles;
+		if (side == PlaneSide::Outside) return;
+		if (side == PlaneSide::Crossing) crossedPlanes.push_back(plane);
+	}
+	std::vector<Plane>& crossedGuardPlanes = context.crossedGuardPlanes;
+	crossedGuardPlanes.clear();
+	if (settings.guardBand) {
+		// nothing's outside these that wasn't outside clippingPlanes
+		for (const Plane& plane : context.guardPlanes) {
+			if (signedDistance(plane, bounds.center) >= bounds.radius) continue;
+			if (boxSide(box, plane) == PlaneSide::Inside) {
+				context.stats.planeTestsAvoided += objectTriangles;
+				continue;
+			}
+			crossedGuardPlanes.push_back(plane);
+		}
+	}
+
+	// The object's points in camera space, with any clipping makes after them. renderScene has
+	// already brought them up to date.
+	rmat3x4 projection = camera.viewportTransform(canvasSize);
+	size_t objectPoints = object.getPoints().size();
+	assertMsg(cacheCurrent(cache, objectInst, object, camera, projection),
+	          "Instances must be transformed before they're rendered.");
+	std::pmr::vector<rvec3>& points = cache.points;
+	std::vector<ivec2>& projected = cache.projected;
+	// drop whatever clipping added last frame
+	points.resize(objectPoints);
+	projected.resize(objectPoints);
+
+	// The mesh itself is shared, so triangles that don't need clipping are read straight from it;
+	// only the ones that do get copied, into clipped.
+	ClipBuffer clipped{points, &context.arena};
+	std::pmr::vector<uint> unclipped{&context.arena}; // indices into the object's triangles
+	unclipped.reserve(object.getTriangles().size());
+	for (uint i = 0; i < object.getTriangles().size(); i++) {
+		const ColoredTriangle& triangle = object.getTriangles()[i];
+		Triangle<rvec3> vertices{points[triangle.triangle[0]], points[triangle.triangle[1]],
+		                         points[triangle.triangle[2]]};
+		// back faces are culled before clipping, since clipping doesn't turn a triangle around
+		if (backFacing(vertices)) continue;
+
+		// Triangles off to the side are still thrown out, but ones only partly off the canvas
+		// are left for the scissor, as long as they don't reach past the guard band (or behind
+		// the viewport, where they can't be projected).
+		PlaneSide side = classifyTriangle(vertices, crossedPlanes);
+		if (side == PlaneSide::Crossing and settings.guardBand)
+			side = classifyTriangle(vertices, crossedGuardPlanes);
+
+		switch (side) {
+		case PlaneSide::Inside: unclipped.push_back(i); break;
+		case PlaneSide::Outside: break;
+		case PlaneSide::Crossing:
+			clipIntoBuffer(clipped, triangle,
+			               settings.guardBand ? crossedGuardPlanes : crossedPlanes);
+			context.stats.trianglesClipped++;
+			break;
 		}
+	}
 
-		dvec4 homogenous = {vertex.x, vertex.y, vertex.z, 1};
-		dvec3 homogenous2d =
-		    camera.viewportTransform({canvas.getWidth(), canvas.getHeight()}) * homogenous;
+	// project the points clipping added
+	for (size_t i = projected.size(); i < points.size(); i++) {
+		const rvec3& vertex = points[i];
+		rvec4 homogenous = {vertex.x, vertex.y, vertex.z, 1};
+		rvec3 homogenous2d = projection * homogenous;
 
-		glm::dvec2 canvasPoint;
+		rvec2 canvasPoint;
 		// if the vertex if bad, just ignore it because clipping should have removed all triangles
 		// that use it
 		if (std::abs(homogenous2d.z) > 0.001) {
@@ -108,89 +279,364 @@ static void renderInstance(SextantDrawing& canvas, boost::multi_array<float, 2>&
 		} else {
 			canvasPoint = {0, 0};
 		}
-		projected.push_back(canvasPoint);
+		projected.push_back(toSubpixel(canvasPoint));
 	}
 
 	if (debugFrame) {
-		std::println(std::cerr, "Rendering instance @ {}.", copied->getTransform());
+		std::println(std::cerr, "Rendering instance @ {:.2f}.", objectInst.fromObjectSpace());
 		for (uint i = 0; i < projected.size(); i++) {
 			std::println(std::cerr, "{} {} {}", glm::to_string(projected[i]),
-			             glm::to_string(copied->getPoints()[i]),
-			             glm::length(copied->getPoints()[i]));
+			             glm::to_string(points[i]), glm::length(points[i]));
 		}
 	}
 
-	for (const ColoredTriangle& triangle : copied->getTriangles()) {
+	// Everything is lit in camera space, with the lights renderScene already moved there, so
+	// the only thing left to work out per instance is how its normals get there.
+	auto setupStart = std::chrono::steady_clock::now();
+	ShadingMode shadingMode = object.getShadingMode().value_or(settings.shading);
+	rmat4 camToObj = objectInst.toObjectSpace() * camera.fromCameraSpace();
+	const SpecularLut* specularLut = settings.specularLut ? object.getSpecularLut() : NULL;
+	uint shadingIndex;
+	InstanceShading& shading = context.bins.addInstance(shadingIndex);
+	shading.ambientLight = ambientLight;
+	shading.specular = object.getSpecular();
+	shading.normalToCam = glm::transpose(rmat3(camToObj));
+	shading.lights = &lights;
+	shading.lightGrid = context.activeLightGrid();
+	shading.shadingMode = shadingMode;
+	shading.specularLut = specularLut;
+	context.stats.shadingSetupTime += std::chrono::steady_clock::now() - setupStart;
+	context.stats.instancesShaded++;
+
+	// Gouraud shading lights each vertex once, and every triangle using it with the same normal
+	// shares the result. Vertices on hard edges have a different normal for each face, so those
+	// get lit again for every one of them.
+	// The G-buffer is lit per pixel anyways, so deferred rendering doesn't need any of this.
+	bool lightVertices = shadingMode == ShadingMode::Gouraud and not settings.deferred;
+	std::vector<real>& vertexLighting = context.vertexLighting;
+	std::vector<rvec3>& vertexNormals = context.vertexNormals; // what vertexLighting was from
+	if (lightVertices) {
+		vertexLighting.assign(points.size(), std::numeric_limits<real>::quiet_NaN());
+		vertexNormals.resize(points.size());
+	}
+	auto lightVertex = [&](const uint vertex, const rvec3& normal) {
+		if (not std::isnan(vertexLighting[vertex]) and vertexNormals[vertex] == normal)
+			return vertexLighting[vertex];
+
+		real lighting =
+		    computeLighting(points[vertex], origin, glm::normalize(shading.normalToCam * normal),
+		                    object.getSpecular(), ambientLight, lights, specularLut);
+		if (std::isnan(vertexLighting[vertex])) {
+			vertexLighting[vertex] = lighting;
+			vertexNormals[vertex] = normal;
+		}
+		return lighting;
+	};
+
+	auto binTriangle = [&](const ColoredTriangle& triangle) {
 		if (debugFrame) { // print 3d points, renderTriangle prints 2d points
 			std::println(std::cerr, "Drawing tri {};\nnormals: {}.",
-			             copied->getDvecTri(triangle.triangle), triangle.normals);
+			             Triangle<rvec3>{points[triangle.triangle[0]], points[triangle.triangle[1]],
+			                             points[triangle.triangle[2]]},
+			             triangle.normals);
 			std::println(std::cerr,
 			             "Object transform: {:.2f}\nInv obj: {:.2f}\n"
 			             "Camera transform: {:.2f}\nJoined: {:.2f}",
-			             copied->toObjectSpace(), copied->fromObjectSpace(),
-			             camera.fromCameraSpace(),
-			             copied->toObjectSpace() * camera.fromCameraSpace());
+			             objectInst.toObjectSpace(), objectInst.fromObjectSpace(),
+			             camera.fromCameraSpace(), camToObj);
+		}
+		Triangle<real> lighting{0, 0, 0};
+		if (lightVertices) {
+			for (uint i = 0; i < 3; i++) {
+				lighting[i] = lightVertex(triangle.triangle[i], triangle.normals[i]);
+			}
 		}
-		renderTriangle(
-		    canvas, depthBuffer,
+
+		context.bins.addTriangle({
 		    {projected[triangle.triangle[0]], projected[triangle.triangle[1]],
 		     projected[triangle.triangle[2]]},
 		    {
-		        static_cast<float>(glm::length(copied->getPoints()[triangle.triangle[0]])),
-		        static_cast<float>(glm::length(copied->getPoints()[triangle.triangle[1]])),
-		        static_cast<float>(glm::length(copied->getPoints()[triangle.triangle[2]])),
+		        static_cast<float>(glm::length(points[triangle.triangle[0]])),
+		        static_cast<float>(glm::length(points[triangle.triangle[1]])),
+		        static_cast<float>(glm::length(points[triangle.triangle[2]])),
 		    },
-		    triangle.normals, triangle.color, ambientLight, copied->getSpecular(), camera,
-		    (copied->toObjectSpace() * camera.fromCameraSpace()), instLights);
+		    triangle.normals,
+		    lighting,
+		    triangle.color,
+		    shadingIndex,
+		});
+	};
+
+	// untouched triangles first, then clipped ones, each in mesh order
+	for (uint i : unclipped) {
+		binTriangle(object.getTriangles()[i]);
+	}
+	for (const ColoredTriangle& triangle : clipped.getTriangles()) {
+		binTriangle(triangle);
+	}
+}
+
+// enough triangles to keep every thread busy, but few enough that instance rejection still works
+constexpr size_t FLUSH_TRIANGLES = 4096;
+
+// how much nearer than its bounds an instance is treated as when testing it against occluders
+constexpr float OCCLUSION_SLACK = 1e-3;
+
+// front to back, with ties in scene order; for pairs from RenderContext::ordered
+static bool nearerFirst(const std::pair<real, const InstanceRef3D*>& a,
+                        const std::pair<real, const InstanceRef3D*>& b) {
+	return a.first < b.first or (a.first == b.first and a.second < b.second);
+}
+
+// Brings the cache of every one of instances up to date, transforming all the out of date ones
+// together. Skips occluders, which already have been.
+// Instances of the same mesh (and level of detail) share one copy of its points in the stream,
+// and are kept next to each other so it stays in cache while they're transformed.
+static void transformStale(RenderContext& context, const Scene& scene,
+                           const std::vector<std::pair<real, const InstanceRef3D*>>& instances,
+                           const rmat3x4& projection) {
+	context.vertexStream.clear();
+	context.pendingTransforms.clear();
+	// each mesh's place in the stream; out of the arena, so it doesn't allocate every frame
+	std::pmr::unordered_map<const Object3D*, size_t> meshSources{&context.arena};
+	for (const auto& [nearest, objectInst] : instances) {
+		if (std::ranges::binary_search(context.occluders, objectInst)) continue;
+
+		VertexCache& cache = context.vertexCaches[objectInst - scene.instances.data()];
+		const Object3D& object = drawnObject(context, scene, *objectInst);
+		const std::vector<rvec3>& objectPoints = object.getPoints();
+		if (cacheCurrent(cache, *objectInst, object, scene.camera, projection)) {
+			context.stats.verticesCached += objectPoints.size();
+		} else {
+			auto [source, added] = meshSources.try_emplace(&object, 0);
+			if (added) {
+				source->second = context.vertexStream.append(objectPoints);
+				context.stats.meshesTransformed++;
+			}
+			size_t target = context.vertexStream.reserveOutput(objectPoints.size());
+			context.pendingTransforms.push_back(
+			    {objectInst, &object, &cache, source->second, target});
+			context.stats.verticesTransformed += objectPoints.size();
+			context.stats.instancesTransformed++;
+		}
 	}
+	// Every mesh has its own source, and targets only go up, so this keeps scene order within
+	// each mesh without stable_sort's allocation.
+	std::ranges::sort(context.pendingTransforms, {}, [](const PendingTransform& pending) {
+		return std::pair{pending.source, pending.target};
+	});
+
+	auto transformStart = std::chrono::steady_clock::now();
+	transformPending(context, scene.camera, projection);
+	context.stats.transformTime += std::chrono::steady_clock::now() - transformStart;
 }
 
-void renderScene(SextantDrawing& canvas, const Scene& scene) {
-	boost::multi_array<float, 2> depthBuffer; // TODO: don't reallocate every frame
-	depthBuffer.resize(boost::extents[canvas.getHeight()][canvas.getWidth()]); // coords are (y, x)
+// Draws the occluder's triangles into the occlusion buffer, as far as they're certain to be
+// drawn later: back faces never are, and clipped ones might come out smaller.
+static void drawOccluder(RenderContext& context, const Object3D& object,
+                         const VertexCache& cache, const ivec2 canvasSize) {
+	for (const ColoredTriangle& triangle : object.getTriangles()) {
+		const Triangle<uint>& indices = triangle.triangle;
+		Triangle<rvec3> vertices{cache.points[indices[0]], cache.points[indices[1]],
+		                         cache.points[indices[2]]};
+		if (backFacing(vertices)) continue;
+		if (classifyTriangle(vertices, context.clippingPlanes) != PlaneSide::Inside) continue;
 
-	for (uint y = 0; y < depthBuffer.shape()[0]; y++) {
-		for (uint x = 0; x < depthBuffer.shape()[1]; x++) {
-			depthBuffer[y][x] = 0;
+		// the same depths renderInstance bins it with
+		Triangle<real> nearness;
+		for (uint i = 0; i < 3; i++) {
+			nearness[i] = 1 / static_cast<real>(static_cast<float>(glm::length(vertices[i])));
 		}
+		drawOccluderTriangle(context.occlusionBuffer, OCCLUSION_SCALE, canvasSize,
+		                     context.settings.engine,
+		                     {cache.projected[indices[0]], cache.projected[indices[1]],
+		                      cache.projected[indices[2]]},
+		                     nearness);
+	}
+}
+
+// whether the instance is certainly behind the occluders
+static bool instanceOccluded(const DepthBuffer& occlusionBuffer, const Camera& camera,
+                             const InstanceRef3D& objectInst, const ivec2 canvasSize) {
+	Sphere bounds = camSpaceBoundingSphere(camera, objectInst);
+	ScreenRect rect;
+	if (not sphereBounds(bounds, camera, canvasSize, rect)) return false;
+
+	// to cells, rounding outwards (anything off the canvas is clipped anyways)
+	auto cell = [](const int sextant) { return sextant >= 0 ? sextant / OCCLUSION_SCALE : -1; };
+	// a bit nearer than the sphere really gets, so rounding can't hide what would show
+	float nearest = (1 + OCCLUSION_SLACK) / (glm::length(bounds.center) - bounds.radius);
+	return occlusionBuffer.rectHidden(cell(rect.minRow), cell(rect.minCol), cell(rect.maxRow),
+	                                  cell(rect.maxCol), nearest);
+}
+
+// Draws the nearest few instances into the occlusion buffer, then takes everything they
+// certainly hide out of context.ordered, before anything else is transformed. The occluders go
+// in context.occluders (sorted by address), already transformed.
+static void cullOccluded(RenderContext& context, const Scene& scene, const ivec2 canvasSize,
+                         const rmat3x4& projection) {
+	std::vector<std::pair<real, const InstanceRef3D*>>& ordered = context.ordered;
+	// ordered is only sorted if the hierarchical z buffer is on
+	std::vector<std::pair<real, const InstanceRef3D*>>& nearest = context.nearestScratch;
+	nearest.assign(ALL_OF(ordered));
+	size_t count = std::min<size_t>(context.settings.occluders, nearest.size());
+	std::partial_sort(nearest.begin(), nearest.begin() + count, nearest.end(), nearerFirst);
+	nearest.resize(count);
+	transformStale(context, scene, nearest, projection);
+
+	for (const auto& [distance, objectInst] : nearest) {
+		context.occluders.push_back(objectInst);
+		drawOccluder(context, drawnObject(context, scene, *objectInst),
+		             context.vertexCaches[objectInst - scene.instances.data()], canvasSize);
 	}
+	std::ranges::sort(context.occluders);
+
+	std::erase_if(ordered, [&](const std::pair<real, const InstanceRef3D*>& entry) {
+		const InstanceRef3D& objectInst = *entry.second;
+		if (std::ranges::binary_search(context.occluders, &objectInst)) return false;
+		if (not instanceOccluded(context.occlusionBuffer, scene.camera, objectInst, canvasSize))
+			return false;
+		context.stats.instancesOccluded++;
+		context.stats.trianglesOccluded +=
+		    drawnObject(context, scene, objectInst).getTriangles().size();
+		return true;
+	});
+}
+
+// whether the instance is certainly behind what's already in the depth buffer
+static bool instanceHidden(const DepthBuffer& depthBuffer, const Camera& camera,
+                           const InstanceRef3D& objectInst, const ivec2 canvasSize) {
+	Sphere bounds = camSpaceBoundingSphere(camera, objectInst);
+
+	// anything crossing the viewport gets clipped, which is too complicated to predict
+	ScreenRect rect;
+	if (not sphereBounds(bounds, camera, canvasSize, rect)) return false;
+
+	// depths are distances from the camera, and nothing in the sphere is nearer than this
+	float nearest = 1.0 / (glm::length(bounds.center) - bounds.radius);
+	return depthBuffer.rectHidden(rect.minRow, rect.minCol, rect.maxRow, rect.maxCol, nearest);
+}
+
+// the light markers only get the ambient light
+static const LightTable NO_LIGHTS{};
+
+void renderScene(SextantDrawing& canvas, const Scene& scene, RenderContext& context) {
+	const RenderSettings& settings = context.settings;
+	context.beginFrame(canvas, scene.camera);
+	DepthBuffer& depthBuffer = context.depthBuffer;
+	TriangleBins& bins = context.bins;
+	GBuffer* gBuffer = settings.deferred ? &context.gBuffer : NULL;
+	const ivec2 canvasSize{canvas.getWidth(), canvas.getHeight()};
 
 	if (debugFrame) std::println(std::cerr, "camera at {}", scene.camera.toCameraSpace());
 
-	std::vector<std::shared_ptr<Light>> translatedLights =
-	    translateLights(scene.lights, scene.camera.toCameraSpace());
-
-	if (debugFrame)
-		for (std::shared_ptr<Light> lightPtr : translatedLights) {
-			dvec3 lightDir = lightPtr->getDirection(origin);
-			dvec4 homogenous = {lightDir.x, lightDir.y, lightDir.z, 1};
-			dvec3 homogenous2d =
-			    scene.camera.viewportTransform({canvas.getWidth(), canvas.getHeight()})
-			    * homogenous;
-			if (floatCmp(homogenous2d.z, 0.0)) continue;
+	// the only time the scene's lights are looked at; everything after uses the tables
+	context.sceneLights.assign(scene.lights);
+	if (settings.shadows) {
+		context.stats.shadowMapsDrawn =
+		    context.shadowMaps.update(context.sceneLights, scene.instances, &context.arena);
+		context.sceneLights.shadows = &context.shadowMaps;
+	}
+	LightTable& translatedLights = context.cameraLights;
+	translatedLights.assignTransformed(context.sceneLights, scene.camera.toCameraSpace());
+	if (settings.lightCulling) context.lightGrid.build(translatedLights, scene.camera, canvasSize);
+
+	if (debugFrame) {
+		uint markerShading;
+		InstanceShading& marker = bins.addInstance(markerShading);
+		marker.ambientLight = 0.5;
+		marker.specular = -1;
+		marker.normalToCam = glm::identity<rmat3>();
+		marker.lights = &NO_LIGHTS;
+		marker.lightGrid = NULL;
+		marker.shadingMode = ShadingMode::Phong;
+		marker.specularLut = NULL;
+		for (size_t light = 0; light < translatedLights.size(); light++) {
+			rvec3 lightDir = translatedLights.getDirection(light, origin);
+			rvec4 homogenous = {lightDir.x, lightDir.y, lightDir.z, 1};
+			rvec3 homogenous2d =
+			    scene.camera.viewportTransform(canvasSize) * homogenous;
+			if (floatCmp<real>(homogenous2d.z, 0)) continue;
 			ivec2 point = canonicalize(homogenous2d);
 
 			float dist = glm::length(lightDir);
 
-			renderTriangle(canvas, depthBuffer,
-			               {
-			                   point + ivec2{2,  0 },
-                                 point + ivec2{-1, -1},
-                                 point + ivec2{-1, 1 }
-            },
-			               {dist, dist, dist}, {dvec3{-1, 0, 0}, {-1, 0, 0}, {-1, 0, 0}}, cblack,
-			               0.5, -1, scene.camera, glm::identity<dmat4>(), {});
+			bins.addTriangle({
+			    {(point + ivec2{2, 0}) * SUBPIXEL_SCALE, (point + ivec2{-1, -1}) * SUBPIXEL_SCALE,
+			     (point + ivec2{-1, 1}) * SUBPIXEL_SCALE},
+			    {dist, dist, dist},
+			    {rvec3{-1, 0, 0}, {-1, 0, 0}, {-1, 0, 0}},
+			    {0, 0, 0},
+			    cblack, markerShading
+            });
 		}
+	}
+
+	// Front to back, so the hierarchical z buffer has something to reject later instances with.
+	// Sorted by the nearest point of the bounding sphere, with ties kept in scene order (the
+	// pointers are into scene.instances). stable_sort would do the same, but allocates.
+	std::vector<std::pair<real, const InstanceRef3D*>>& ordered = context.ordered;
+	ordered.clear();
+	context.vertexCaches.resize(scene.instances.size());
+	context.lodLevels.resize(scene.instances.size(), 0);
+	rmat3x4 projection = scene.camera.viewportTransform(canvasSize);
+	findCandidates(context, scene);
+	for (uint32_t index : context.candidates) {
+		const InstanceRef3D& objectInst = scene.instances[index];
+		Sphere bounds = camSpaceBoundingSphere(scene.camera, objectInst);
+		if (outsideAnyPlane(bounds, context.clippingPlanes)) continue;
+		// the box is tighter, but more work, so it only gets a look at what the sphere keeps
+		OrientedBox box = camSpaceBox(scene.camera, objectInst, objectInst.getBoundingBox());
+		if (std::ranges::any_of(context.clippingPlanes, [&](const Plane& plane) {
+			    return boxSide(box, plane) == PlaneSide::Outside;
+		    })) {
+			context.stats.instancesCulledByBox++;
+			continue;
+		}
+		ordered.push_back({glm::length(bounds.center) - bounds.radius, &objectInst});
+		context.stats.instancesInView++;
+
+		const Object3D& full = objectInst.getObject();
+		uint& level = context.lodLevels[index];
+		level = settings.lod ? pickLod(full, bounds, scene.camera, canvasSize, level) : 0;
+		size_t drawnTriangles = full.getLod(level).getTriangles().size();
+		context.stats.trianglesSavedByLod +=
+		    full.getTriangles().size() - std::min(drawnTriangles, full.getTriangles().size());
+	}
+	if (settings.hierarchicalZ) std::sort(ALL_OF(ordered), nearerFirst);
+
+	context.occluders.clear();
+	if (settings.occluders != 0) cullOccluded(context, scene, canvasSize, projection);
+	// Everything that's left gets transformed all at once. That includes instances the
+	// hierarchical z buffer goes on to reject, since it can't until earlier ones are drawn.
+	transformStale(context, scene, ordered, projection);
+
+	for (const auto& [nearest, objectInst] : ordered) {
+		if (settings.hierarchicalZ
+		    and instanceHidden(depthBuffer, scene.camera, *objectInst, canvasSize))
+			continue;
+		VertexCache& cache = context.vertexCaches[objectInst - scene.instances.data()];
+		renderInstance(context, canvasSize, scene.camera, *objectInst,
+		               drawnObject(context, scene, *objectInst), cache, scene.ambientLight,
+		               translatedLights);
+
+		// Draw what's binned every so often, so later instances have a depth buffer to be
+		// rejected against. The output is the same either way.
+		if (settings.hierarchicalZ and bins.triangleCount() >= FLUSH_TRIANGLES)
+			bins.flush(canvas, depthBuffer, gBuffer, settings, scene.camera, context.pool);
+	}
+	bins.flush(canvas, depthBuffer, gBuffer, settings, scene.camera, context.pool);
 
-	for (const InstanceRef3D& objectInst : scene.instances) {
-		renderInstance(canvas, depthBuffer, scene.camera, objectInst, scene.ambientLight,
-		               scene.lights);
+	// everything visible is known now, so light each sextant once
+	if (gBuffer != NULL) {
+		shadeGBuffer(canvas, *gBuffer, scene.ambientLight, translatedLights,
+		             context.activeLightGrid(), context.pool);
 	}
 
 	if (debugFrame) {
-		for (uint y = 0; y < depthBuffer.shape()[0]; y++) {
-			for (uint x = 0; x < depthBuffer.shape()[1]; x++) {
-				std::print(std::cerr, "{:.2f} ", depthBuffer[y][x]);
+		for (int y = 0; y < depthBuffer.getHeight(); y++) {
+			for (int x = 0; x < depthBuffer.getWidth(); x++) {
+				std::print(std::cerr, "{:.2f} ", depthBuffer.get(y, x));
 			}
 			std::println(std::cerr, "");
 		}
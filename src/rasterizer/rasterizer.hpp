@@ -1,11 +1,13 @@
 #ifndef RASTERIZER_HPP
 #define RASTERIZER_HPP
 #include "../drawing/sextantBlocks.hpp"
+#include "renderContext.hpp"
 #include "scene.hpp"
 #include <glm/exponential.hpp>
 
-using glm::dvec3, glm::dvec4, glm::ivec2, glm::dmat4;
+using glm::ivec2;
 
-void renderScene(SextantDrawing& canvas, const Scene& scene);
+// context must be reused for every frame, see RenderContext
+void renderScene(SextantDrawing& canvas, const Scene& scene, RenderContext& context);
 
 #endif /* RASTERIZER_HPP */
@@ -0,0 +1,51 @@
+#include "renderContext.hpp"
+
+#include <algorithm>
+#include <thread>
+
+// 0 threads means one per core
+static uint poolSize(const uint threads) {
+	return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+RenderContext::RenderContext(const RenderSettings& settings)
+    : settings(settings), pool(poolSize(settings.threads)), depthBuffer(0, 0), bins(0, 0),
+      gBuffer(0, 0), occlusionBuffer(0, 0) {}
+
+void RenderContext::beginFrame(const SextantDrawing& canvas, const Camera& camera) {
+	int height = canvas.getHeight();
+	int width = canvas.getWidth();
+
+	// resizing a multi_array always reallocates, even to the same size
+	if (this->depthBuffer.getHeight() != height or this->depthBuffer.getWidth() != width)
+		this->depthBuffer.resize(height, width);
+	else this->depthBuffer.clear();
+
+	if (this->bins.getHeight() != height or this->bins.getWidth() != width)
+		this->bins.resize(height, width);
+
+	if (this->settings.deferred) {
+		if (this->gBuffer.getHeight() != height or this->gBuffer.getWidth() != width)
+			this->gBuffer.resize(height, width);
+		else this->gBuffer.clear();
+	}
+
+	if (this->settings.occluders != 0) {
+		int cellsHigh = (height + OCCLUSION_SCALE - 1) / OCCLUSION_SCALE;
+		int cellsWide = (width + OCCLUSION_SCALE - 1) / OCCLUSION_SCALE;
+		if (this->occlusionBuffer.getHeight() != cellsHigh
+		    or this->occlusionBuffer.getWidth() != cellsWide)
+			this->occlusionBuffer.resize(cellsHigh, cellsWide);
+		else this->occlusionBuffer.clear();
+	}
+
+	this->arena.reset();
+	this->stats = {};
+
+	rvec3 viewport{camera.viewportWidth, camera.viewportHeight, camera.viewportDistance};
+	if (viewport != this->planesViewport) {
+		this->clippingPlanes = camera.getClippingPlanes();
+		this->guardPlanes = camera.getClippingPlanes(GUARD_BAND);
+		this->planesViewport = viewport;
+	}
+}
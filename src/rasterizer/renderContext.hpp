@@ -0,0 +1,150 @@
+#ifndef RENDERCONTEXT_HPP
+#define RENDERCONTEXT_HPP
+#include "../drawing/sextantBlocks.hpp"
+#include "../util/frameArena.hpp"
+#include "../util/threadPool.hpp"
+#include "binning.hpp"
+#include "deferred.hpp"
+#include "depthBuffer.hpp"
+#include "instanceBvh.hpp"
+#include "lightGrid.hpp"
+#include "lightTable.hpp"
+#include "renderable.hpp"
+#include "settings.hpp"
+#include "shadeKernel.hpp"
+#include "shadowMaps.hpp"
+#include "structures.hpp"
+#include "vertexKernel.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// sextants across (and down) a cell of the occlusion buffer
+constexpr int OCCLUSION_SCALE = 4;
+// With guard-band clipping, how many times the view's width and height triangles can reach
+// before they're clipped. Small enough that subpixel coordinates can't overflow.
+constexpr real GUARD_BAND = 16;
+
+// An instance's points in camera space and projected, kept from the last frame it was drawn.
+// Only good while the instance, its object (at the level of detail it's drawn with), the camera,
+// and the projection are all unchanged.
+struct VertexCache {
+	uint64_t instanceVersion = 0;
+	uint64_t objectVersion = 0;
+	uint64_t cameraVersion = 0;
+	rmat3x4 projection{0};
+	// The object's own points come first. Anything after them was added by clipping, and only
+	// belongs to the frame that did it.
+	std::pmr::vector<rvec3> points;
+	std::vector<ivec2> projected; // in subpixels, same indices as points
+};
+
+// an instance whose mesh is in a VertexStream, waiting to be transformed into its cache
+struct PendingTransform {
+	const InstanceRef3D* instance;
+	const Object3D* object; // the level of detail it's drawn with
+	VertexCache* cache;
+	size_t source; // where the mesh's points start in the stream, shared by its instances
+	size_t target; // where this instance's transformed points go in the stream's outputs
+};
+
+// counts for the current frame, reset by RenderContext::beginFrame
+struct RenderStats {
+	size_t verticesTransformed = 0;
+	size_t verticesCached = 0; // reused from a VertexCache instead of transformed
+	std::chrono::nanoseconds transformTime{0}; // spent transforming and projecting vertices
+	size_t instancesShaded = 0; // that renderInstance set up an InstanceShading for
+	std::chrono::nanoseconds shadingSetupTime{0}; // spent setting those up
+	size_t shadowMapsDrawn = 0; // lights whose shadow maps were out of date
+	size_t instancesInView = 0; // that weren't culled against the clipping planes
+	size_t instancesOccluded = 0; // of those, the ones the occluders certainly hid
+	size_t trianglesOccluded = 0; // in the hidden instances' meshes
+	// in view, how many fewer triangles the chosen levels of detail have than the full meshes
+	size_t trianglesSavedByLod = 0;
+	size_t trianglesClipped = 0; // that went through clipIntoBuffer
+	// in view of their bounding spheres, but not their boxes
+	size_t instancesCulledByBox = 0;
+	// Triangle against plane tests skipped, because an instance's box settled which side of a
+	// plane it's on when its sphere couldn't. At least one per triangle for each plane.
+	size_t planeTestsAvoided = 0;
+	size_t instancesTransformed = 0;
+	size_t meshesTransformed = 0; // different ones among those instances
+};
+
+// Everything renderScene keeps from one frame to the next: the buffers, the thread pool, and
+// scratch space that would otherwise be allocated for every frame (or every instance).
+// Keep one around for as long as you're drawing to a canvas. Nothing is reallocated unless the
+// canvas changes size, and the scratch vectors only ever grow.
+struct RenderContext {
+	const RenderSettings settings;
+	ThreadPool pool;
+	DepthBuffer depthBuffer;
+	TriangleBins bins;
+	GBuffer gBuffer; // stays empty unless rendering deferred
+	// for geometry that only lasts a frame (instances' camera space points and clipped
+	// triangles); reset by beginFrame, so bytesUsed() afterwards is what the last frame took
+	FrameArena arena;
+
+	// the camera's, only rebuilt when its viewport changes
+	std::vector<Plane> clippingPlanes;
+	std::vector<Plane> guardPlanes; // the same, with the sides pushed out to the guard band
+	// the scene's lights as they were given, and moved into camera space
+	LightTable sceneLights;
+	LightTable cameraLights;
+	LightGrid lightGrid; // built from cameraLights, unless light culling is off
+	ShadowMaps shadowMaps; // for sceneLights, if shadows are on
+
+	// over the scene's instances, unless it's turned off
+	InstanceBvh instanceBvh;
+	std::vector<Plane> worldPlanes; // clippingPlanes, moved into world space for the BVH
+	std::vector<uint32_t> candidates; // instances the BVH couldn't cull, in scene order
+
+	// The farthest of the occluders in each OCCLUSION_SCALE square cell of the canvas, for
+	// throwing out instances behind them before they're transformed.
+	DepthBuffer occlusionBuffer;
+	std::vector<const InstanceRef3D*> occluders; // this frame's, sorted by address
+
+	// one for each of the scene's instances, in the same order
+	std::vector<VertexCache> vertexCaches;
+	// The level of detail each was last drawn with. Levels only change once an instance is well
+	// past where they switch, so they don't flicker back and forth.
+	std::vector<uint> lodLevels;
+	// every out of date cache's points, transformed together before any instance is drawn
+	VertexStream vertexStream;
+	std::vector<PendingTransform> pendingTransforms;
+	std::vector<size_t> transformJobs; // scratch: where each of the pool's jobs starts
+	RenderStats stats;
+
+	// scratch for renderInstance
+	std::vector<Plane> crossedPlanes; // the clipping planes the instance's bounds cross
+	std::vector<Plane> crossedGuardPlanes; // likewise for guardPlanes
+	std::vector<real> vertexLighting;
+	std::vector<rvec3> vertexNormals;
+	// scratch for renderScene: instances, with the distance to the nearest point of their bounds
+	std::vector<std::pair<real, const InstanceRef3D*>> ordered;
+	std::vector<std::pair<real, const InstanceRef3D*>> nearestScratch; // for picking occluders
+
+	explicit RenderContext(const RenderSettings& settings);
+
+	RenderContext(const RenderContext&) = delete;
+	RenderContext& operator=(const RenderContext&) = delete;
+
+	// sizes the buffers to the canvas (only reallocating if it changed) and clears them, resets
+	// the arena and stats, and rebuilds the clipping planes if the camera's viewport changed
+	void beginFrame(const SextantDrawing& canvas, const Camera& camera);
+
+	// the grid, if this frame's lights are being culled
+	[[nodiscard]] const LightGrid* activeLightGrid() const {
+		return this->settings.lightCulling and this->lightGrid.isActive() ? &this->lightGrid
+		                                                                  : NULL;
+	}
+
+  private:
+	rvec3 planesViewport{-1, -1, -1}; // width, height, and distance clippingPlanes were made for
+};
+
+#endif /* RENDERCONTEXT_HPP */
@@ -1,215 +1,187 @@
 #include "renderable.hpp"
 
+#include "glm/common.hpp"
 #include "glm/geometric.hpp"
-#include "interpolate.hpp"
 
+#include <algorithm>
+#include <array>
 #include <ranges>
 
-Sphere createBoundingSphere(const std::vector<dvec3>& points) {
-	Sphere output;
+Sphere createBoundingSphere(const std::span<const rvec3> points) {
+	if (points.empty()) return {origin, 0};
+
+	// Ritter's: start with the two points furthest apart along a rough diameter, then grow just
+	// enough to take in every point left outside
+	auto furthestFrom = [&](const rvec3& from) {
+		return *std::ranges::max_element(points, {}, [&](const rvec3& point) {
+			return glm::distance(from, point);
+		});
+	};
+	rvec3 start = furthestFrom(points[0]);
+	rvec3 end = furthestFrom(start);
+	Sphere ritter{(start + end) / static_cast<real>(2), glm::distance(start, end) / 2};
+	for (const rvec3& point : points) {
+		real distance = glm::distance(ritter.center, point);
+		if (distance <= ritter.radius) continue;
+		real radius = (ritter.radius + distance) / 2;
+		ritter.center += (distance - radius) / distance * (point - ritter.center);
+		ritter.radius = radius;
+	}
 
-	dvec3 pointsSum;
-	for (const dvec3& point : points) {
+	rvec3 pointsSum{0, 0, 0};
+	for (const rvec3& point : points) {
 		pointsSum += point;
 	}
-	output.center = pointsSum / static_cast<double>(points.size());
-
-	double maxDist = 0;
-	for (const dvec3& point : points) {
-		if (maxDist < glm::distance(output.center, point)) {
-			maxDist = glm::distance(output.center, point);
+	Sphere centroid{pointsSum / static_cast<real>(points.size()), 0};
+
+	// Either center works; the radius is found again from scratch, so rounding while growing
+	// can't leave a point just outside.
+	auto radiusAround = [&](const rvec3& center) {
+		real maxDist = 0;
+		for (const rvec3& point : points) {
+			maxDist = std::max(maxDist, glm::distance(center, point));
 		}
+		return maxDist;
+	};
+	ritter.radius = radiusAround(ritter.center);
+	centroid.radius = radiusAround(centroid.center);
+	return ritter.radius <= centroid.radius ? ritter : centroid;
+}
+
+BoundingBox createBoundingBox(const std::span<const rvec3> points) {
+	if (points.empty()) return {origin, origin};
+	BoundingBox box{points[0], points[0]};
+	for (const rvec3& point : points) {
+		box.min = glm::min(box.min, point);
+		box.max = glm::max(box.max, point);
 	}
-	output.radius = maxDist;
+	return box;
+}
 
-	return output;
+Sphere transformSphere(const Sphere& sphere, const rmat4& matrix) {
+	rmat3 linear{matrix};
+	real scale =
+	    std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+	return {canonicalize(matrix * toHomogenous(sphere.center)), sphere.radius * scale};
 }
 
-double signedDistance(const Plane& plane, const dvec3& vertex) {
+OrientedBox transformBox(const BoundingBox& box, const rmat4& matrix) {
+	rmat3 linear{matrix};
+	rvec3 halfSize = (box.max - box.min) / static_cast<real>(2);
+	return {
+	    canonicalize(matrix * toHomogenous((box.min + box.max) / static_cast<real>(2))),
+	    {linear[0] * halfSize.x, linear[1] * halfSize.y, linear[2] * halfSize.z}
+    };
+}
+
+real signedDistance(const Plane& plane, const rvec3& vertex) {
 	return vertex.x * plane.normal.x + //
 	       vertex.y * plane.normal.y + //
 	       vertex.z * plane.normal.z //
 	       + plane.distance;
 }
 
-// reorganize the triangle so index is the first v alue
-// preserves order, so back face culling still works
-template <typename T> Triangle<T> reorderTri(Triangle<T>& tri, const int index) {
-	Triangle<T> out;
-
-	int from = index; // the index to copy from
-	int to = 0; // the index to copy to
-
-	while (to != 3) {
-		out[to] = tri[from];
-
-		to++;
-		from++;
-		if (from > 2) from = 0; // wrap around
+namespace {
+// A convex polygon partway through being clipped. Each plane adds at most one vertex, so it never
+// needs more room than this, and lives on the stack.
+struct ClipPolygon {
+	struct Vertex {
+		rvec3 point;
+		rvec3 normal;
+		uint index; // in the vertex buffer
+	};
+
+	std::array<Vertex, 3 + MAX_CLIP_PLANES> vertices;
+	uint size = 0;
+};
+} // namespace
+
+// Sutherland-Hodgman: keeps what's inside the plane, with a new vertex wherever an edge crosses it.
+// planeIndex is which of the planes being clipped against plane is.
+// @return false if nothing is left
+static bool clipPolygon(ClipBuffer& clipped, const ClipPolygon& polygon, const Plane& plane,
+                        const uint planeIndex, ClipPolygon& out) {
+	std::array<real, 3 + MAX_CLIP_PLANES> distances;
+	uint inside = 0;
+	for (uint i = 0; i < polygon.size; i++) {
+		distances[i] = signedDistance(plane, polygon.vertices[i].point);
+		// same test as classifyTriangle
+		if (distances[i] >= 0) inside++;
+	}
+	if (inside == 0) return false;
+	if (inside == polygon.size) {
+		out = polygon;
+		return true;
 	}
 
-	return out;
-}
-
-// finds the first vertex that makes selector true
-template <typename T, typename lambdaType>
-int whichOf(const Triangle<T>& tri, const lambdaType& selector) {
-	for (uint i = 0; i < tri.size(); i++) {
-		if (selector(tri[i])) return i;
+	out.size = 0;
+	for (uint i = 0; i < polygon.size; i++) {
+		uint next = i + 1 == polygon.size ? 0 : i + 1;
+		const ClipPolygon::Vertex& current = polygon.vertices[i];
+		if (distances[i] >= 0) out.vertices[out.size++] = current;
+		if ((distances[i] >= 0) == (distances[next] >= 0)) continue;
+
+		// Always from the inside end, so the triangle on the other side of a shared edge gets
+		// exactly the same point and there's no crack between them.
+		bool currentInside = distances[i] >= 0;
+		const ClipPolygon::Vertex& from = currentInside ? current : polygon.vertices[next];
+		const ClipPolygon::Vertex& to = currentInside ? polygon.vertices[next] : current;
+		auto [t, intersection] = intersectPlaneSegT({from.point, to.point}, plane);
+		out.vertices[out.size++] = {
+		    intersection, glm::normalize(from.normal + t * (to.normal - from.normal)),
+		    clipped.addEdgePoint(planeIndex, from.index, to.index, intersection)};
 	}
-	return -1;
+	return true;
 }
 
-void clipTriangle(InstanceSC3D& inst, const Plane& plane, const uint targetIdx) {
-	ColoredTriangle target = inst.getTriangle(targetIdx);
-	Triangle<uint>& targetTri = target.triangle;
-	Triangle<dvec3>& normals = target.normals;
-	if (targetTri == NO_TRIANGLE.triangle) return;
-	Color color = inst.getTriangle(targetIdx).color;
+void clipIntoBuffer(ClipBuffer& clipped, const ColoredTriangle& triangle,
+                    const std::vector<Plane>& planes) {
+	assertLtEq(planes.size(), size_t{MAX_CLIP_PLANES}, "Too many planes to clip against.");
+	uint first = clipped.getTriangles().size();
 
-	Triangle<double> distances{};
+	// clipped back and forth between the two
+	ClipPolygon polygons[2];
+	ClipPolygon* polygon = &polygons[0];
 	for (uint i = 0; i < 3; i++) {
-		distances[i] = signedDistance(plane, inst.getPoint(targetTri[i]));
-	}
-	uchar numPositive = (distances[0] >= 0) + (distances[1] >= 0) + (distances[2] >= 0);
-
-	if (numPositive == 3) { // fully inside plane
-		return;
-
-	} else if (numPositive == 1) { // 1 vertex inside
-		// make targetTri[0] be the only positive vertex
-		int positiveIdx = whichOf(distances, [](const double& num) { return num >= 0; });
-		targetTri = reorderTri(targetTri, positiveIdx);
-		normals = reorderTri(normals, positiveIdx);
-
-		auto vertexA = intersectPlaneSegT(
-		    std::make_pair(inst.getPoint(targetTri[0]), inst.getPoint(targetTri[1])), plane);
-		auto vertexB = intersectPlaneSegT(
-		    std::make_pair(inst.getPoint(targetTri[0]), inst.getPoint(targetTri[2])), plane);
-
-		inst.setTriangle(targetIdx, NO_TRIANGLE);
-
-		// this will create duplicate points, but catching those would be too much work
-		inst.addTriangle({
-		    {targetTri[0], inst.addVertex(vertexA.intersection),
-		     inst.addVertex(vertexB.intersection)                     },
-		    color,
-		    {normals[0],
-		     {interpolateValue(normals[0].x, normals[1].x, vertexA.t),
-		      interpolateValue(normals[0].y, normals[1].y, vertexA.t),
-		      interpolateValue(normals[0].z, normals[1].z, vertexA.t)},
-		     {interpolateValue(normals[0].x, normals[2].x, vertexA.t),
-		      interpolateValue(normals[0].y, normals[2].y, vertexA.t),
-		      interpolateValue(normals[0].z, normals[2].z, vertexA.t)}}
-        });
-
-	} else if (numPositive == 2) { // 2 verticies inside
-		// make targetTri[0] be the only negative vertex
-		int negativeIdx = whichOf(distances, [](const double& num) { return num < 0; });
-		targetTri = reorderTri(targetTri, negativeIdx);
-		normals = reorderTri(normals, negativeIdx);
-
-		auto p1Prime = intersectPlaneSegT(
-		    std::make_pair(inst.getPoint(targetTri[0]), inst.getPoint(targetTri[1])), plane);
-		auto p2Prime = intersectPlaneSegT(
-		    std::make_pair(inst.getPoint(targetTri[0]), inst.getPoint(targetTri[2])), plane);
-
-		uint p1Idx = inst.addVertex(p1Prime.intersection);
-		uint p2Idx = inst.addVertex(p2Prime.intersection);
-
-		inst.setTriangle(targetIdx, NO_TRIANGLE);
-
-		dvec3 p1Normals =
-		    glm::normalize(dvec3{interpolateValue(normals[0].x, normals[1].x, p1Prime.t),
-		                         interpolateValue(normals[0].y, normals[1].y, p1Prime.t),
-		                         interpolateValue(normals[0].z, normals[1].z, p1Prime.t)});
-
-		dvec3 p2Normals =
-		    glm::normalize(dvec3{interpolateValue(normals[0].x, normals[2].x, p1Prime.t),
-		                         interpolateValue(normals[0].y, normals[2].y, p1Prime.t),
-		                         interpolateValue(normals[0].z, normals[2].z, p1Prime.t)});
-
-		inst.addTriangle({
-		    {p1Idx,     targetTri[1], targetTri[2]},
-            color, {p1Normals, normals[1],   normals[2]  }
-        });
-		inst.addTriangle({
-		    {targetTri[2], p2Idx,     p1Idx    },
-            color, {normals[2],   p2Normals, p1Normals}
-        });
-
-	} else if (numPositive == 0) { // all outside
-		inst.setTriangle(targetIdx, NO_TRIANGLE);
+		polygon->vertices[i] = {clipped.getPoint(triangle.triangle[i]), triangle.normals[i],
+		                        triangle.triangle[i]};
 	}
-}
-
-void clipInstance(std::unique_ptr<InstanceSC3D>& inst, const std::vector<Plane>& planes) {
-	assert(inst != NULL); // a reference to a pointer... makes sense...
-
-	for (const Plane& plane : planes) {
-		Sphere bounding = inst->getBoundingSphere();
-		double distance = signedDistance(plane, bounding.center);
-
-		if (distance >= bounding.radius) { // fully inside
-			pass();
-
-		} else if (distance <= -bounding.radius) { // fully outside
-			inst = NULL;
-			return;
-
-		} else { // split
-			// clipping creates more triangles; we don't want to clip them again for no reason
-			uint numTriangles = inst->getTriangles().size();
-
-			for (uint i = 0; i < numTriangles; i++) {
-				clipTriangle(*inst, plane, i);
-				if (debugFrame)
-					std::println(
-					    std::cerr, "tris after clipping: {}",
-					    inst->getTriangles()
-					        | std::ranges::views::filter(
-					            [](const ColoredTriangle& tri) { return not(tri == NO_TRIANGLE); })
-					        | std::ranges::views::transform([&inst](const ColoredTriangle& tri) {
-						          return inst->getDvecTri(tri.triangle);
-					          }));
-			}
-		}
+	polygon->size = 3;
+	for (uint i = 0; i < planes.size(); i++) {
+		ClipPolygon* out = polygon == &polygons[0] ? &polygons[1] : &polygons[0];
+		if (not clipPolygon(clipped, *polygon, planes[i], i, *out)) return;
+		polygon = out;
 	}
 
-	inst->clearEmptyTris();
-	inst->clearUnusedPoints();
-}
-
-std::unique_ptr<InstanceSC3D> backFaceCulling(std::unique_ptr<InstanceSC3D> inst) {
-	// this algorithm requires vertices to be clockwise
-	for (uint triIdx = 0; triIdx < inst->getTriangles().size(); triIdx++) {
-		ColoredTriangle tri = inst->getTriangle(triIdx);
-
-		// camera is at {0, 0, 0}, so this is the vector from the camera to triangle
-		dvec3 cameraVector = -inst->getPoint(tri.triangle[0]);
-
-		dvec3 triVecA = inst->getPoint(tri.triangle[1]) - inst->getPoint(tri.triangle[0]);
-		dvec3 triVecB = inst->getPoint(tri.triangle[2]) - inst->getPoint(tri.triangle[0]);
-		dvec3 triNormal = glm::cross(triVecA, triVecB); // normal vector of triangle
-
-		// the == case is for directly side on triangles, so don't render them
-		if (glm::dot(triNormal, cameraVector) <= 0) inst->setTriangle(triIdx, NO_TRIANGLE);
+	// a fan keeps the triangle's winding
+	const ClipPolygon::Vertex& hub = polygon->vertices[0];
+	for (uint i = 1; i + 1 < polygon->size; i++) {
+		const ClipPolygon::Vertex& a = polygon->vertices[i];
+		const ClipPolygon::Vertex& b = polygon->vertices[i + 1];
+		clipped.addTriangle({
+		    {hub.index,  a.index,  b.index },
+		    triangle.color,
+		    {hub.normal, a.normal, b.normal}
+        });
 	}
 
-	inst->clearEmptyTris();
-	return inst;
+	if (debugFrame)
+		std::println(std::cerr, "tris after clipping: {}",
+		             clipped.getTriangles() | std::ranges::views::drop(first)
+		                 | std::ranges::views::transform([&clipped](const ColoredTriangle& tri) {
+			                   return clipped.getDvecTri(tri.triangle);
+		                   }));
 }
 
-void InstanceSC3D::clearUnusedPoints() {
-	std::vector<bool> usedMap(this->getPoints().size(), false);
-	for (const ColoredTriangle& tri : this->getTriangles()) {
-		for (uint i : tri.triangle) {
-			if (tri != NO_TRIANGLE) usedMap[i] = true;
-		}
-	}
-
-	for (uint i = 0; i < this->getPoints().size(); i++) {
-		// actually deleting them would break all subsequent indexes
-		if (usedMap[i] == false) this->getPoint(i) = NO_POINT;
+PlaneSide classifyTriangle(const Triangle<rvec3>& vertices, const std::vector<Plane>& planes) {
+	PlaneSide side = PlaneSide::Inside;
+	for (const Plane& plane : planes) {
+		// same test as clipPolygon, so anything Inside really would be left alone
+		uchar numPositive = (signedDistance(plane, vertices[0]) >= 0)
+		                    + (signedDistance(plane, vertices[1]) >= 0)
+		                    + (signedDistance(plane, vertices[2]) >= 0);
+		if (numPositive == 0) return PlaneSide::Outside;
+		if (numPositive != 3) side = PlaneSide::Crossing;
 	}
+	return side;
 }
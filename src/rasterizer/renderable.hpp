@@ -3,25 +3,48 @@
 #include "../drawing/setColor.hpp"
 #include "../extraAssertions.hpp"
 #include "../util/formatters.hpp"
+#include "../util/specularLut.hpp"
+#include "settings.hpp"
 #include "structures.hpp"
-#include <glm/ext/matrix_double3x3.hpp>
-#include <glm/ext/matrix_double4x4.hpp>
 #include <glm/ext/matrix_transform.hpp>
-#include <glm/ext/vector_double3.hpp>
 #include <glm/geometric.hpp>
 #include <glm/gtx/hash.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <cmath>
+#include <limits>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <utility>
 
-using glm::dvec3, glm::dmat4, glm::dvec4;
+// A small sphere holding every one of points: Ritter's, or the one around their centroid if
+// that's smaller. Usually close to the smallest possible, and much closer than the centroid's
+// alone for lopsided meshes.
+Sphere createBoundingSphere(const std::span<const rvec3> points);
 
-Sphere createBoundingSphere(const std::vector<dvec3>& points);
+BoundingBox createBoundingBox(const std::span<const rvec3> points);
 
-double signedDistance(const Plane& plane, const dvec3& vertex);
+// moves the sphere by matrix; the radius grows with the largest scale, so it still holds the same
+// points
+Sphere transformSphere(const Sphere& sphere, const rmat4& matrix);
 
-inline dvec3 intersectPlaneSeg(const std::pair<dvec3, dvec3>& segment, const Plane& plane) {
-	double t = (-plane.distance - glm::dot(plane.normal, segment.first))
-	           / glm::dot(plane.normal, segment.second - segment.first);
+// moves the box by matrix (which has to be affine), so it still holds the same points
+OrientedBox transformBox(const BoundingBox& box, const rmat4& matrix);
+
+real signedDistance(const Plane& plane, const rvec3& vertex);
+
+// the furthest the box reaches from its center, along the plane's normal
+inline real boxReach(const OrientedBox& box, const Plane& plane) {
+	return std::abs(glm::dot(plane.normal, box.halfSides[0]))
+	     + std::abs(glm::dot(plane.normal, box.halfSides[1]))
+	     + std::abs(glm::dot(plane.normal, box.halfSides[2]));
+}
+
+inline rvec3 intersectPlaneSeg(const std::pair<rvec3, rvec3>& segment, const Plane& plane) {
+	real t = (-plane.distance - glm::dot(plane.normal, segment.first))
+	         / glm::dot(plane.normal, segment.second - segment.first);
 	return segment.first + t * (segment.second - segment.first);
 }
 
@@ -29,12 +52,12 @@ inline dvec3 intersectPlaneSeg(const std::pair<dvec3, dvec3>& segment, const Pla
 // does not check the indexes are valid
 inline void validateTri(const ColoredTriangle& tri) {
 	if (tri == NO_TRIANGLE) return;
-	forAll(tri.normals, [](const dvec3& normal) {
+	forAll(tri.normals, [](const rvec3& normal) {
 		assertFiniteVec(normal, "Normals must be finite.");
 		assertBetweenIncl(0.999, glm::length(normal), 1.001, "Normals need a length of 1.");
 	});
-	forAllPairs(tri.normals, [](const std::pair<dvec3, dvec3> normalPair) {
-		dvec3 sum = normalPair.first + normalPair.second;
+	forAllPairs(tri.normals, [](const std::pair<rvec3, rvec3> normalPair) {
+		rvec3 sum = normalPair.first + normalPair.second;
 		assertGt(std::abs(sum.x) + std::abs(sum.y) + std::abs(sum.z), 0.001,
 		         "Normals can't point directly away from each other.");
 	});
@@ -44,20 +67,20 @@ inline void validateTri(ColoredTriangle& tri) {}
 #endif
 
 struct IntersectPlaneSegTRetVal {
-	double t;
-	dvec3 intersection;
+	real t;
+	rvec3 intersection;
 };
 
 // also return the t value
 // t describes how far across this intersection is, from 0 to 1
-inline IntersectPlaneSegTRetVal intersectPlaneSegT(const std::pair<dvec3, dvec3>& segment,
+inline IntersectPlaneSegTRetVal intersectPlaneSegT(const std::pair<rvec3, rvec3>& segment,
                                                    const Plane& plane) {
-	double t = (-plane.distance - glm::dot(plane.normal, segment.first))
-	           / glm::dot(plane.normal, segment.second - segment.first);
+	real t = (-plane.distance - glm::dot(plane.normal, segment.first))
+	         / glm::dot(plane.normal, segment.second - segment.first);
 	return {t, segment.first + t * (segment.second - segment.first)};
 }
 
-inline dvec3 canonicalize(const dvec4& homogenous) {
+inline rvec3 canonicalize(const rvec4& homogenous) {
 	return {
 	    homogenous.x / homogenous.w,
 	    homogenous.y / homogenous.w,
@@ -65,50 +88,64 @@ inline dvec3 canonicalize(const dvec4& homogenous) {
 	};
 }
 
-inline glm::dvec2 canonicalize(const dvec3& homogenous) {
+inline rvec2 canonicalize(const rvec3& homogenous) {
 	return {
 	    homogenous.x / homogenous.z,
 	    homogenous.y / homogenous.z,
 	};
 }
 
-inline dvec4 toHomogenous(const dvec3& point, const uint w = 1) {
+inline rvec4 toHomogenous(const rvec3& point, const uint w = 1) {
 	return {point.x, point.y, point.z, w};
 }
 
-inline dvec3 toHomogenous(const glm::dvec2& point, const uint w = 1) {
+inline rvec3 toHomogenous(const rvec2& point, const uint w = 1) {
 	return {point.x, point.y, w};
 }
 
 class Object3D {
   private:
 	mutable std::optional<Sphere> cachedSphere{};
-	std::vector<dvec3> points;
+	mutable std::optional<BoundingBox> cachedBox{};
+	std::vector<rvec3> points;
 	std::vector<ColoredTriangle> triangles;
-	double specular;
+	real specular;
+	const SpecularLut* specularLut; // NULL without a highlight
+	std::optional<ShadingMode> shadingMode{}; // empty to use RenderSettings::shading
+	uint64_t version = newVersion(); // changes with the points or triangles
+	// coarser versions of this, each with the projected radius it's used below
+	std::vector<std::pair<std::shared_ptr<const Object3D>, real>> lods;
+
+	void changed() {
+		this->version = newVersion();
+		this->cachedSphere = {};
+		this->cachedBox = {};
+	}
 
   public:
-	Object3D(const std::vector<dvec3>& points, const std::vector<ColoredTriangle> triangles,
-	         const double specular)
-	    : points(points), triangles(triangles), specular(specular) {
+	Object3D(const std::vector<rvec3>& points, const std::vector<ColoredTriangle> triangles,
+	         const real specular)
+	    : points(points), triangles(triangles), specular(specular),
+	      specularLut(specular != -1 ? &specularLutFor(specular) : NULL) {
 #ifndef NDEBUG
-		for (const dvec3& point : points) {
+		for (const rvec3& point : points) {
 			assertFiniteVec(point, "Points must be finite in objects.");
 		}
 #endif
 	}
 
-	const std::vector<dvec3>& getPoints() const { return this->points; }
+	const std::vector<rvec3>& getPoints() const { return this->points; }
 
 	const std::vector<ColoredTriangle>& getTriangles() const { return this->triangles; }
 
-	dvec3 getPoint(const uint idx) const { return this->points.at(idx); }
+	rvec3 getPoint(const uint idx) const { return this->points.at(idx); }
 
 	ColoredTriangle getTriangle(const uint idx) const { return this->triangles.at(idx); }
 
-	void setPoint(const uint idx, const dvec3& val) {
+	void setPoint(const uint idx, const rvec3& val) {
 		assertFiniteVec(val, "Setting point to non finite value in object.");
 		this->points.at(idx) = val;
+		this->changed();
 	}
 
 	void setTriangle(const uint idx, const ColoredTriangle& val) {
@@ -118,18 +155,26 @@ class Object3D {
 			}
 		validateTri(val);
 		this->triangles.at(idx) = val;
+		this->changed();
 	}
 
-	Triangle<dvec3> getDvecTri(Triangle<uint> tri) {
+	Triangle<rvec3> getDvecTri(Triangle<uint> tri) {
 		return {this->points[tri[0]], this->points[tri[1]], this->points[tri[2]]};
 	};
 
-	double getSpecular() const { return this->specular; }
+	real getSpecular() const { return this->specular; }
+
+	const SpecularLut* getSpecularLut() const { return this->specularLut; }
+
+	const std::optional<ShadingMode>& getShadingMode() const { return this->shadingMode; }
+
+	void setShadingMode(const std::optional<ShadingMode> mode) { this->shadingMode = mode; }
 
 	// @return the added vertex's index
-	[[nodiscard]] uint addVertex(const dvec3& vertex) {
+	[[nodiscard]] uint addVertex(const rvec3& vertex) {
 		assertFiniteVec(vertex, "Vertexes must be finite in objects.");
 		this->points.push_back(vertex);
+		this->changed();
 		return this->points.size() - 1;
 	}
 
@@ -140,81 +185,132 @@ class Object3D {
 			}
 		validateTri(triangle);
 		this->triangles.push_back(triangle);
+		this->changed();
 	}
 
-	void clearEmptyTris() { std::erase(this->triangles, NO_TRIANGLE); }
+	void clearEmptyTris() {
+		std::erase(this->triangles, NO_TRIANGLE);
+		this->changed();
+	}
+
+	uint64_t getVersion() const { return this->version; }
 
 	const Sphere& getBoundingSphere() const {
 		if (not this->cachedSphere.has_value())
 			this->cachedSphere = createBoundingSphere(getPoints());
 		return this->cachedSphere.value();
 	}
+
+	// in object space; tighter than the sphere for long or flat meshes
+	const BoundingBox& getBoundingBox() const {
+		if (not this->cachedBox.has_value()) this->cachedBox = createBoundingBox(getPoints());
+		return this->cachedBox.value();
+	}
+
+	// Adds a coarser level of detail, drawn instead of this once the bounding sphere's radius is
+	// under maxRadius sextants on screen. Each level has to be used at a smaller size than the
+	// last. Culling goes by this object's bounds, so levels should fit inside them.
+	void addLod(const std::shared_ptr<const Object3D>& mesh, const real maxRadius) {
+		assertMsg(mesh.get() != this and mesh != NULL, "Levels of detail need another mesh.");
+		assertGt(maxRadius, 0, "Levels of detail need a positive radius.");
+		if (not this->lods.empty())
+			assertLt(maxRadius, this->lods.back().second, "Levels must get used smaller.");
+		this->lods.push_back({mesh, maxRadius});
+	}
+
+	// including this one, which is level 0
+	size_t getLodCount() const { return this->lods.size() + 1; }
+
+	const Object3D& getLod(const size_t level) const {
+		if (level == 0) return *this;
+		return *this->lods.at(level - 1).first;
+	}
+
+	// the projected radius (in sextants) the level is used below; infinite for level 0
+	real getLodRadius(const size_t level) const {
+		if (level == 0) return std::numeric_limits<real>::infinity();
+		return this->lods.at(level - 1).second;
+	}
 };
 
 // Uses a pointer to the object to save space.
-// Unfortunately, this doesn't really work for clipping.
+// Clipping goes through a ClipBuffer, so only triangles that actually get cut are copied.
 class InstanceRef3D {
   private:
-	friend class InstanceSC3D;
 	std::shared_ptr<Object3D> object3d;
 	Transform transform;
-	mutable std::optional<dmat4> cachedTransform{};
-	mutable std::optional<dmat4> cachedInvTransform{};
-	mutable std::optional<Sphere> cachedSphere{};
+	uint64_t version = newVersion(); // changes with the transform
+	mutable std::optional<rmat4> cachedTransform{};
+	mutable std::optional<rmat4> cachedInvTransform{};
 
   public:
 	InstanceRef3D(const std::shared_ptr<Object3D> object3d, const Transform& tr)
 	    : object3d(object3d), transform(tr) {}
 
+	const Object3D& getObject() const { return *this->object3d; }
+
+	const Transform& getTransform() const { return this->transform; }
+
+	void setTransform(const Transform& tr) {
+		this->transform = tr;
+		this->cachedTransform = {};
+		this->cachedInvTransform = {};
+		this->version = newVersion();
+	}
+
+	uint64_t getVersion() const { return this->version; }
+
 	// parses to a matrix
-	const dmat4& fromObjectSpace() const {
+	const rmat4& fromObjectSpace() const {
 		if (not this->cachedTransform.has_value())
 			this->cachedTransform = parseTransform(this->transform);
 		return this->cachedTransform.value();
 	};
 
-	const dmat4& toObjectSpace() const {
+	const rmat4& toObjectSpace() const {
 		if (not this->cachedInvTransform.has_value())
 			this->cachedInvTransform = parseTransform(invertTransform(this->transform));
 		return this->cachedInvTransform.value();
 	};
 
-	Sphere getBoundingSphere() const {
-		if (not this->cachedSphere.has_value())
-			this->cachedSphere = createBoundingSphere(this->object3d->getPoints());
-		return this->cachedSphere.value();
-	};
+	// in object space
+	Sphere getBoundingSphere() const { return this->object3d->getBoundingSphere(); };
+
+	// in object space
+	const BoundingBox& getBoundingBox() const { return this->object3d->getBoundingBox(); };
 };
 
-// Fully Self Contained (SC) instance.
-// Useful for clipping.
-class InstanceSC3D {
+// Triangles cut up by clipping, and the points that adds.
+// The points go on the end of the caller's vertex buffer, so indices into it from before clipping
+// still work. Meant to last a frame, like the buffer; both usually come out of a FrameArena.
+class ClipBuffer {
   private:
-	std::vector<dvec3> points;
-	std::vector<ColoredTriangle> triangles;
-	Transform transform;
-	double specular;
-	mutable std::optional<dmat4> cachedTransform{};
-	mutable std::optional<dmat4> cachedInvTransform{};
-	mutable std::optional<Sphere> cachedSphere{};
+	std::pmr::vector<rvec3>& points;
+	std::pmr::vector<ColoredTriangle> triangles;
+	// the point each (plane, inside point, outside point) edge crossing was given
+	std::pmr::map<std::tuple<uint, uint, uint>, uint> edgePoints;
 
   public:
-	InstanceSC3D(const InstanceRef3D& ref)
-	    : points(ref.object3d->getPoints()), triangles(ref.object3d->getTriangles()),
-	      transform(ref.transform), specular(ref.object3d->getSpecular()),
-	      cachedTransform(ref.fromObjectSpace()), cachedSphere(ref.getBoundingSphere()) {}
-
-	InstanceSC3D(const InstanceSC3D& inst)
-	    : points(inst.points), triangles(inst.triangles), transform(inst.transform),
-	      specular(inst.specular) {}
+	ClipBuffer(std::pmr::vector<rvec3>& points, std::pmr::memory_resource* memory)
+	    : points(points), triangles(memory), edgePoints(memory) {}
 
 	// @return the added vertex's index
-	[[nodiscard]] uint addVertex(const dvec3& vertex) {
-		assertFiniteVec(vertex, "Vertexes must be finite in instances.");
+	[[nodiscard]] uint addVertex(const rvec3& vertex) {
+		assertFiniteVec(vertex, "Vertexes must be finite in clipped triangles.");
 		this->points.push_back(vertex);
 		return this->points.size() - 1;
 	}
 
+	// The index of point, where the edge from the inside point to the outside one (by index)
+	// crosses plane (by its index in the planes clipped against), adding it the first time.
+	// Triangles sharing an edge share the point too.
+	[[nodiscard]] uint addEdgePoint(const uint plane, const uint inside, const uint outside,
+	                                const rvec3& point) {
+		auto [edge, added] = this->edgePoints.try_emplace({plane, inside, outside}, 0);
+		if (added) edge->second = this->addVertex(point);
+		return edge->second;
+	}
+
 	void addTriangle(const ColoredTriangle& triangle) {
 		if (triangle != NO_TRIANGLE)
 			for (uint i = 0; i < 3; i++) {
@@ -224,133 +320,117 @@ class InstanceSC3D {
 		this->triangles.push_back(triangle);
 	}
 
-	const std::vector<dvec3>& getPoints() const { return this->points; }
-
-	const std::vector<ColoredTriangle>& getTriangles() const { return this->triangles; }
-
-	dvec3 getPoint(const uint idx) const { return this->points.at(idx); }
-
-	ColoredTriangle getTriangle(const uint idx) const { return this->triangles.at(idx); }
-
-	void setPoint(const uint idx, const dvec3& val) {
-		assertFiniteVec(val, "Setting point to non finite value in instance.");
-		this->points.at(idx) = val;
-	}
+	const std::pmr::vector<ColoredTriangle>& getTriangles() const { return this->triangles; }
 
-	void setTriangle(const uint idx, const ColoredTriangle& val) {
-		if (val != NO_TRIANGLE)
-			for (uint i = 0; i < 3; i++) {
-				assertLt(val.triangle[i], this->points.size(), "val index out of range.");
-			}
-		validateTri(val);
-		this->triangles.at(idx) = val;
-	}
+	rvec3 getPoint(const uint idx) const { return this->points.at(idx); }
 
 	// don't use this very much; it's inefficient
-	Triangle<dvec3> getDvecTri(Triangle<uint> tri) {
+	Triangle<rvec3> getDvecTri(Triangle<uint> tri) {
 		return {this->points[tri[0]], this->points[tri[1]], this->points[tri[2]]};
 	};
-
-	void clearEmptyTris() { std::erase(this->triangles, NO_TRIANGLE); }
-
-	// remove any points not referenced by a triangle
-	// sets them to NO_POINT
-	void clearUnusedPoints();
-
-	Sphere getBoundingSphere() const {
-		if (not this->cachedSphere.has_value())
-			this->cachedSphere = createBoundingSphere(this->points);
-		return this->cachedSphere.value();
-	};
-
-	void setTransform(const Transform& tr) {
-		this->transform = tr;
-		this->cachedTransform = {};
-	}
-
-	const Transform& getTransform() const { return this->transform; }
-
-	double getSpecular() const { return this->specular; }
-
-	// parses to a matrix
-	const dmat4& fromObjectSpace() const {
-		if (not this->cachedTransform.has_value())
-			this->cachedTransform = parseTransform(this->transform);
-		return this->cachedTransform.value();
-	};
-
-	const dmat4& toObjectSpace() const {
-		if (not this->cachedInvTransform.has_value())
-			this->cachedInvTransform = parseTransform(invertTransform(this->transform));
-		return this->cachedInvTransform.value();
-	};
-
-	virtual ~InstanceSC3D() = default;
 };
 
-// clips the triangle in inst at index targetIdx
-void clipTriangle(InstanceSC3D& inst, const Plane& plane, const uint targetIdx);
+// most planes clipIntoBuffer can take at once
+constexpr uint MAX_CLIP_PLANES = 8;
+
+// Clips the triangle against every plane in one go, as a polygon, and adds what's left to clipped
+// as a fan. Nothing is ever removed, and each point clipping makes is only added once, even when
+// neighboring triangles cross the same edge; so every triangle in clipped has to be clipped
+// against the same planes.
+void clipIntoBuffer(ClipBuffer& clipped, const ColoredTriangle& triangle,
+                    const std::vector<Plane>& planes);
+
+// where a triangle is compared to a set of planes
+enum class PlaneSide {
+	Inside, // of every plane; clipping wouldn't change it
+	Outside, // fully, of at least one plane
+	Crossing // anything else; it needs clipping
+};
 
-void clipInstance(std::unique_ptr<InstanceSC3D>& inst, const std::vector<Plane>& planes);
+PlaneSide classifyTriangle(const Triangle<rvec3>& vertices, const std::vector<Plane>& planes);
 
-// should be called with camera-relative coordinates
-std::unique_ptr<InstanceSC3D> backFaceCulling(std::unique_ptr<InstanceSC3D> inst);
+// should be called with camera-relative coordinates (and clockwise vertices)
+// side on triangles count too, since there's nothing to draw
+inline bool backFacing(const Triangle<rvec3>& vertices) {
+	// camera is at {0, 0, 0}, so this is the vector from the camera to triangle
+	rvec3 cameraVector = -vertices[0];
+	rvec3 triNormal = glm::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]);
+	return glm::dot(triNormal, cameraVector) <= 0;
+}
 
 enum class LightType { Point, Directional };
 
+// Lights as they're given to a Scene. The renderer flattens them into a LightTable once a frame,
+// and never calls any of this while shading.
 class Light {
   protected:
 	friend class std::formatter<Light>;
 	virtual std::string stringify() const = 0;
 
   public:
-	virtual dvec3 getDirection([[maybe_unused]] dvec3 point) const = 0;
-	virtual double getIntensity() const = 0;
+	virtual rvec3 getDirection([[maybe_unused]] rvec3 point) const = 0;
+	virtual real getIntensity() const = 0;
+	// how far away it can light anything; infinite for lights that don't fade
+	virtual real getRange() const = 0;
 	virtual LightType getType() const = 0; // screw "good polymorphic design"
 	virtual ~Light() = default;
 };
 
 class DirectionalLight : public Light {
   private:
-	double intensity;
-	dvec3 direction;
+	real intensity;
+	rvec3 direction;
 
 	std::string stringify() const {
 		return std::format("DirectionalLight(direction:{}, intensity:{})", direction, intensity);
 	}
 
   public:
-	DirectionalLight(double intensity, dvec3 direction)
+	DirectionalLight(real intensity, rvec3 direction)
 	    : intensity(intensity), direction(glm::normalize(direction)) {}
 
-	virtual dvec3 getDirection([[maybe_unused]] dvec3 point) const { return this->direction; }
+	virtual rvec3 getDirection([[maybe_unused]] rvec3 point) const { return this->direction; }
+
+	virtual real getIntensity() const { return this->intensity; }
 
-	virtual double getIntensity() const { return this->intensity; }
+	rvec3 getDirection() const { return this->direction; }
 
-	dvec3 getDirection() const { return this->direction; }
+	virtual real getRange() const { return std::numeric_limits<real>::infinity(); }
 
 	virtual LightType getType() const { return LightType::Directional; }
 
 	virtual ~DirectionalLight() = default;
 };
 
+// Lights everything equally by default. Given a range, it fades out smoothly (by
+// (1 - distance^2 / range^2)^2) and lights nothing past it, which lets light culling skip it.
 class PointLight : public Light {
   private:
-	double intensity;
-	dvec3 position;
+	real intensity;
+	rvec3 position;
+	real range;
 
 	std::string stringify() const {
-		return std::format("PointLight(position:{}, intensity:{})", position, intensity);
+		if (std::isinf(range))
+			return std::format("PointLight(position:{}, intensity:{})", position, intensity);
+		return std::format("PointLight(position:{}, intensity:{}, range:{})", position,
+		                   intensity, range);
 	}
 
   public:
-	PointLight(double intensity, dvec3 position) : intensity(intensity), position(position) {}
+	PointLight(real intensity, rvec3 position,
+	           real range = std::numeric_limits<real>::infinity())
+	    : intensity(intensity), position(position), range(range) {
+		assertGt(range, 0, "Point lights must reach something.");
+	}
+
+	virtual rvec3 getDirection(rvec3 point) const { return this->position - point; }
 
-	virtual dvec3 getDirection(dvec3 point) const { return this->position - point; }
+	virtual real getIntensity() const { return this->intensity; }
 
-	virtual double getIntensity() const { return this->intensity; }
+	rvec3 getPosition() const { return this->position; }
 
-	dvec3 getPosition() const { return this->position; }
+	virtual real getRange() const { return this->range; }
 
 	virtual LightType getType() const { return LightType::Point; }
 
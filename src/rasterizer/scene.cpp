@@ -7,11 +7,11 @@
 [[nodiscard]] Scene initScene() {
 	Camera camera{1, 1, 1};
 	camera.setTransform(
-	    Transform({-3, 1, 0}, glm::yawPitchRoll<double>(glm::radians(-30.0), 0, 0), 1.0));
+	    Transform({-3, 1, 0}, glm::yawPitchRoll<real>(glm::radians(-30.0), 0, 0), 1.0));
 	// camera.setTransform(
-	//     Transform({9, 0, 0}, glm::identity<glm::dmat3>(), 1.0));
+	//     Transform({9, 0, 0}, glm::identity<rmat3>(), 1.0));
 
-	double ambientLight = 0.2;
+	real ambientLight = 0.2;
 	Scene scene{{}, {}, {}, camera, Color(Category(true, 7), RGBA(0, 0, 0, 255)), ambientLight};
 
 	Object3D cube(
@@ -26,18 +26,18 @@
 	        {1,  -1, -1}
     },
 	    {
-	        {{0, 1, 2}, cred, {dvec3{0, 0, 1}, dvec3{0, 0, 1}, dvec3{0, 0, 1}}},
-	        {{0, 2, 3}, cred, {dvec3{0, 0, 1}, dvec3{0, 0, 1}, dvec3{0, 0, 1}}},
-	        {{4, 0, 3}, cgreen, {dvec3{1, 0, 0}, dvec3{1, 0, 0}, dvec3{1, 0, 0}}},
-	        {{4, 3, 7}, cgreen, {dvec3{1, 0, 0}, dvec3{1, 0, 0}, dvec3{1, 0, 0}}},
-	        {{5, 4, 7}, cblue, {dvec3{0, 0, -1}, dvec3{0, 0, -1}, dvec3{0, 0, -1}}},
-	        {{5, 7, 6}, cblue, {dvec3{0, 0, -1}, dvec3{0, 0, -1}, dvec3{0, 0, -1}}},
-	        {{1, 5, 6}, cyellow, {dvec3{-1, 0, 0}, dvec3{-1, 0, 0}, dvec3{-1, 0, 0}}},
-	        {{1, 6, 2}, cyellow, {dvec3{-1, 0, 0}, dvec3{-1, 0, 0}, dvec3{-1, 0, 0}}},
-	        {{4, 5, 1}, cmagenta, {dvec3{0, 1, 0}, dvec3{0, 1, 0}, dvec3{0, 1, 0}}},
-	        {{4, 1, 0}, cmagenta, {dvec3{0, 1, 0}, dvec3{0, 1, 0}, dvec3{0, 1, 0}}},
-	        {{2, 6, 7}, ccyan, {dvec3{0, -1, 0}, dvec3{0, -1, 0}, dvec3{0, -1, 0}}},
-	        {{2, 7, 3}, ccyan, {dvec3{0, -1, 0}, dvec3{0, -1, 0}, dvec3{0, -1, 0}}},
+	        {{0, 1, 2}, cred, {rvec3{0, 0, 1}, rvec3{0, 0, 1}, rvec3{0, 0, 1}}},
+	        {{0, 2, 3}, cred, {rvec3{0, 0, 1}, rvec3{0, 0, 1}, rvec3{0, 0, 1}}},
+	        {{4, 0, 3}, cgreen, {rvec3{1, 0, 0}, rvec3{1, 0, 0}, rvec3{1, 0, 0}}},
+	        {{4, 3, 7}, cgreen, {rvec3{1, 0, 0}, rvec3{1, 0, 0}, rvec3{1, 0, 0}}},
+	        {{5, 4, 7}, cblue, {rvec3{0, 0, -1}, rvec3{0, 0, -1}, rvec3{0, 0, -1}}},
+	        {{5, 7, 6}, cblue, {rvec3{0, 0, -1}, rvec3{0, 0, -1}, rvec3{0, 0, -1}}},
+	        {{1, 5, 6}, cyellow, {rvec3{-1, 0, 0}, rvec3{-1, 0, 0}, rvec3{-1, 0, 0}}},
+	        {{1, 6, 2}, cyellow, {rvec3{-1, 0, 0}, rvec3{-1, 0, 0}, rvec3{-1, 0, 0}}},
+	        {{4, 5, 1}, cmagenta, {rvec3{0, 1, 0}, rvec3{0, 1, 0}, rvec3{0, 1, 0}}},
+	        {{4, 1, 0}, cmagenta, {rvec3{0, 1, 0}, rvec3{0, 1, 0}, rvec3{0, 1, 0}}},
+	        {{2, 6, 7}, ccyan, {rvec3{0, -1, 0}, rvec3{0, -1, 0}, rvec3{0, -1, 0}}},
+	        {{2, 7, 3}, ccyan, {rvec3{0, -1, 0}, rvec3{0, -1, 0}, rvec3{0, -1, 0}}},
 	    },
 	    3);
 	scene.objects.push_back(std::make_shared<Object3D>(cube));
@@ -48,8 +48,8 @@
 	scene.instances.push_back(InstanceRef3D(std::make_shared<Object3D>(cube),
 	                                        {
 	                                            {-1.5, 0, 7},
-	                                            // glm::identity<dmat4>(),
-	                                            glm::yawPitchRoll<double>(glm::radians(90.0), 0, 0),
+	                                            // glm::identity<rmat4>(),
+	                                            glm::yawPitchRoll<real>(glm::radians(90.0), 0, 0),
 	                                            0.75
     }));
 
@@ -64,8 +64,8 @@
 	scene.instances.push_back(InstanceRef3D(
 	    std::make_shared<Object3D>(cube), {
 	                                          {1.25, 2.5, 7.5},
-	                                          // glm::identity<dmat4>(),
-	                                          glm::yawPitchRoll<double>(glm::radians(195.0), 0, 0),
+	                                          // glm::identity<rmat4>(),
+	                                          glm::yawPitchRoll<real>(glm::radians(195.0), 0, 0),
 	                                          1.0
     }));
 
@@ -73,13 +73,13 @@
 	//     InstanceRef3D(std::make_shared<Object3D>(sphere),
 	//                   {
 	//                       {2, 0, 7},
-	// glm::yawPitchRoll<double>(0, 0, 0), 1.0
+	// glm::yawPitchRoll<real>(0, 0, 0), 1.0
 	// }));
 
-	scene.lights.push_back(std::make_shared<DirectionalLight>(0.3, dvec3(1.0, 4.0, 4.0)));
-	scene.lights.push_back(std::make_shared<PointLight>(0.6, dvec3(2.0, 1.0, 0.0)));
-	// scene.lights.push_back(std::make_shared<PointLight>(2, dvec3(2.0, 1.0, 0.0)));
-	// scene.lights.push_back(std::make_shared<DirectionalLight>(0.8, dvec3(1.0, 4.0, 4.0)));
+	scene.lights.push_back(std::make_shared<DirectionalLight>(0.3, rvec3(1.0, 4.0, 4.0)));
+	scene.lights.push_back(std::make_shared<PointLight>(0.6, rvec3(2.0, 1.0, 0.0)));
+	// scene.lights.push_back(std::make_shared<PointLight>(2, rvec3(2.0, 1.0, 0.0)));
+	// scene.lights.push_back(std::make_shared<DirectionalLight>(0.8, rvec3(1.0, 4.0, 4.0)));
 
 	return scene;
 }
@@ -14,7 +14,7 @@ struct Scene {
 	std::vector<std::shared_ptr<Light>> lights;
 	Camera camera;
 	Color bgColor;
-	double ambientLight;
+	real ambientLight;
 };
 
 [[nodiscard]] Scene initScene();
@@ -0,0 +1,104 @@
+#include "settings.hpp"
+
+#include <charconv>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+std::string_view engineName(const RasterEngine engine) {
+	switch (engine) {
+	case RasterEngine::Scanline: return "scanline";
+	case RasterEngine::Tiled: return "tiled";
+	}
+	assertMsg(false, "Unknown engine.");
+	return "";
+}
+
+std::string_view shadingModeName(const ShadingMode mode) {
+	switch (mode) {
+	case ShadingMode::Phong: return "phong";
+	case ShadingMode::Gouraud: return "gouraud";
+	}
+	assertMsg(false, "Unknown shading mode.");
+	return "";
+}
+
+static uint parseUint(const std::string_view arg, const std::string_view value) {
+	uint out;
+	auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), out);
+	if (error != std::errc() or end != value.data() + value.size())
+		throw std::runtime_error(std::format("{} expects a positive integer, got '{}'", arg, value));
+	return out;
+}
+
+ProgramOptions parseArgs(const int argc, const char* const* argv) {
+	ProgramOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		// everything is --name=value
+		std::string_view arg = argv[i];
+		std::string_view value;
+		if (size_t equals = arg.find('='); equals != std::string_view::npos) {
+			value = arg.substr(equals + 1);
+			arg = arg.substr(0, equals);
+		}
+
+		if (arg == "--engine") {
+			if (value == "scanline") options.render.engine = RasterEngine::Scanline;
+			else if (value == "tiled") options.render.engine = RasterEngine::Tiled;
+			else throw std::runtime_error(std::format("Unknown engine '{}'", value));
+		} else if (arg == "--shading") {
+			if (value == "phong") options.render.shading = ShadingMode::Phong;
+			else if (value == "gouraud") options.render.shading = ShadingMode::Gouraud;
+			else throw std::runtime_error(std::format("Unknown shading mode '{}'", value));
+		} else if (arg == "--deferred") {
+			options.render.deferred = true;
+		} else if (arg == "--exact-specular") {
+			options.render.specularLut = false;
+		} else if (arg == "--no-hiz") {
+			options.render.hierarchicalZ = false;
+		} else if (arg == "--no-light-culling") {
+			options.render.lightCulling = false;
+		} else if (arg == "--no-bvh") {
+			options.render.instanceBvh = false;
+		} else if (arg == "--occluders") {
+			options.render.occluders = parseUint(arg, value);
+		} else if (arg == "--no-lod") {
+			options.render.lod = false;
+		} else if (arg == "--no-guard-band") {
+			options.render.guardBand = false;
+		} else if (arg == "--shadows") {
+			options.render.shadows = true;
+		} else if (arg == "--threads") {
+			options.render.threads = parseUint(arg, value);
+		} else if (arg == "--bench") {
+			options.benchFrames = parseUint(arg, value);
+		} else if (arg == "--bench-size") { // HEIGHTxWIDTH, in sextants
+			size_t x = value.find('x');
+			if (x == std::string_view::npos)
+				throw std::runtime_error("--bench-size expects HEIGHTxWIDTH");
+			options.benchHeight = parseUint(arg, value.substr(0, x));
+			options.benchWidth = parseUint(arg, value.substr(x + 1));
+		} else if (arg == "--bench-static") {
+			options.benchStatic = true;
+		} else if (arg == "--bench-lights") {
+			options.benchLights = parseUint(arg, value);
+		} else if (arg == "--bench-spheres") {
+			options.benchSpheres = parseUint(arg, value);
+		} else if (arg == "--bench-forest") {
+			options.benchForest = parseUint(arg, value);
+		} else if (arg == "--bench-specular") {
+			options.benchSpecular = true;
+		} else if (arg == "--bench-clip") {
+			options.benchClip = true;
+		} else if (arg == "--bench-dump") {
+			options.benchDump = value;
+		} else if (arg == "--bench-compare") {
+			options.benchCompare = value;
+		} else {
+			throw std::runtime_error(std::format("Unknown argument '{}'", arg));
+		}
+	}
+
+	return options;
+}
@@ -0,0 +1,81 @@
+#ifndef SETTINGS_HPP
+#define SETTINGS_HPP
+
+#include "../extraAssertions.hpp"
+
+#include <string>
+#include <string_view>
+
+// which algorithm fills in triangles
+enum class RasterEngine {
+	Scanline, // walks the edges row by row (the original)
+	Tiled // edge functions evaluated over small tiles of sextants
+};
+
+std::string_view engineName(const RasterEngine engine);
+
+// where lighting is worked out
+enum class ShadingMode {
+	Phong, // for every pixel, with interpolated normals
+	Gouraud // for every vertex, with the lighting interpolated across the triangle
+};
+
+std::string_view shadingModeName(const ShadingMode mode);
+
+// options that change how a frame is rendered, but not what's in it
+struct RenderSettings {
+	RasterEngine engine = RasterEngine::Scanline;
+	// write a G-buffer first and light each visible sextant once, instead of lighting every pixel
+	// as it's drawn
+	bool deferred = false;
+	// for objects that don't pick their own; deferred rendering always lights per pixel
+	ShadingMode shading = ShadingMode::Phong;
+	// look specular highlights up in shared tables instead of calling pow (see SpecularLut)
+	bool specularLut = true;
+	// reject triangles, tile spans, and whole instances against per-tile depth bounds
+	bool hierarchicalZ = true;
+	// only shade with the lights that can reach each tile (see LightGrid); doesn't change the
+	// output
+	bool lightCulling = true;
+	// find the instances in view with an InstanceBvh instead of testing each one; doesn't change
+	// the output
+	bool instanceBvh = true;
+	// How many of the nearest instances to draw into a coarse depth buffer first, so whatever
+	// they hide can be thrown out before it's transformed. 0 turns it off. Doesn't change the
+	// output.
+	uint occluders = 8;
+	// darken what each light's shadow map says it can't reach (see ShadowMaps)
+	bool shadows = false;
+	// draw objects at coarser levels of detail (see Object3D::addLod) when they're small on screen
+	bool lod = true;
+	// Only clip triangles against the viewport and a guard band far outside the view, and leave
+	// the rest to the rasterizer's scissor. Only changes the output along the canvas's edges.
+	bool guardBand = true;
+	// threads to rasterize with, 0 for one per core; doesn't change the output
+	uint threads = 0;
+};
+
+// everything that can be set from the command line
+struct ProgramOptions {
+	RenderSettings render;
+	uint benchFrames = 0; // if nonzero, render this many frames headless and print timings
+	int benchHeight = 120;
+	int benchWidth = 120;
+	// turn one instance instead of the camera, so most of the scene stays put between frames
+	bool benchStatic = false;
+	// point lights (with ranges) to scatter around the benchmark scene, on top of its own
+	uint benchLights = 0;
+	// spheres with levels of detail, in a row going away from the camera
+	uint benchSpheres = 0;
+	// copies of one tree mesh, in a grid on the ground
+	uint benchForest = 0;
+	bool benchSpecular = false; // if set, compare the specular tables to pow and exit
+	bool benchClip = false; // if set, time the triangle clipper and exit
+	std::string benchDump; // if set, the last benchmark frame is saved here as a PPM
+	std::string benchCompare; // if set, the last benchmark frame is compared to this PPM
+};
+
+// throws std::runtime_error on bad arguments
+ProgramOptions parseArgs(const int argc, const char* const* argv);
+
+#endif /* SETTINGS_HPP */
@@ -0,0 +1,164 @@
+#include "shadeKernel.hpp"
+
+#include "lanes.hpp"
+#include "structures.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void padBatch(LightingBatch& batch) {
+	assertBetweenIncl(1, batch.count, SHADE_BATCH, "Can't pad an empty batch.");
+	for (int lane = batch.count; lane < SHADE_BATCH; lane++) {
+		batch.pointX[lane] = batch.pointX[0];
+		batch.pointY[lane] = batch.pointY[0];
+		batch.pointZ[lane] = batch.pointZ[0];
+		batch.normalX[lane] = batch.normalX[0];
+		batch.normalY[lane] = batch.normalY[0];
+		batch.normalZ[lane] = batch.normalZ[0];
+		batch.specular[lane] = batch.specular[0];
+		batch.specularLut[lane] = batch.specularLut[0];
+	}
+}
+
+// past this, squaring takes long enough that pow is just as good
+constexpr real MAX_INT_EXPONENT = 4096;
+
+namespace {
+// exponentiation by squaring, which unlike pow runs on every lane at once
+inline Lanes powInt(Lanes base, uint exponent) {
+	Lanes result = Lanes::fill(1);
+	while (exponent != 0) {
+		if (exponent & 1) result = result * base;
+		base = base * base;
+		exponent >>= 1;
+	}
+	return result;
+}
+
+inline Lanes dot(const Lanes ax, const Lanes ay, const Lanes az, const Lanes bx, const Lanes by,
+                 const Lanes bz) {
+	return ax * bx + ay * by + az * bz;
+}
+} // namespace
+
+void computeLightingBatch(const LightingBatch& batch, const rvec3 camera, const real ambientLight,
+                          const LightTable& lights, const LightMask* mask, real* out) {
+	static_assert(SHADE_BATCH % Lanes::width == 0);
+	const Lanes zero = Lanes::fill(0);
+	const Lanes noSpecular = Lanes::fill(-1);
+	Lanes fadeSpace[3][3]; // lights.fadeSpace, in registers
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++) {
+			fadeSpace[col][row] = Lanes::fill(lights.fadeSpace[col][row]);
+		}
+	}
+
+	for (int lane = 0; lane < SHADE_BATCH; lane += Lanes::width) {
+		Lanes pointX = Lanes::load(batch.pointX + lane);
+		Lanes pointY = Lanes::load(batch.pointY + lane);
+		Lanes pointZ = Lanes::load(batch.pointZ + lane);
+		Lanes normalX = Lanes::load(batch.normalX + lane);
+		Lanes normalY = Lanes::load(batch.normalY + lane);
+		Lanes normalZ = Lanes::load(batch.normalZ + lane);
+		Lanes specular = Lanes::load(batch.specular + lane);
+
+		Lanes camToPointX = pointX - Lanes::fill(camera.x);
+		Lanes camToPointY = pointY - Lanes::fill(camera.y);
+		Lanes camToPointZ = pointZ - Lanes::fill(camera.z);
+		Lanes camDistance = sqrt(dot(camToPointX, camToPointY, camToPointZ, camToPointX,
+		                             camToPointY, camToPointZ));
+		Lanes normalLength = sqrt(dot(normalX, normalY, normalZ, normalX, normalY, normalZ));
+		Lanes hasSpecular = notEqual(specular, noSpecular);
+
+		// Specular exponents are almost always whole numbers shared by the whole batch (the
+		// forward path only ever has one per triangle), so pow can usually be skipped. Squaring is
+		// exact, so the specular tables aren't used there either.
+		alignas(32) real exponents[Lanes::width];
+		specular.store(exponents);
+		bool sharedIntExponent = exponents[0] >= 0 and exponents[0] <= MAX_INT_EXPONENT
+		                         and exponents[0] == std::floor(exponents[0]);
+		for (int i = 1; i < Lanes::width; i++) {
+			sharedIntExponent = sharedIntExponent and exponents[i] == exponents[0];
+		}
+
+		Lanes intensity = Lanes::fill(ambientLight);
+		const Lanes one = Lanes::fill(1);
+		lights.forEach(mask, [&](const size_t light) {
+			Lanes pointWeight = Lanes::fill(lights.pointWeight[light]);
+			Lanes lightX = Lanes::fill(lights.x[light]) - pointX * pointWeight;
+			Lanes lightY = Lanes::fill(lights.y[light]) - pointY * pointWeight;
+			Lanes lightZ = Lanes::fill(lights.z[light]) - pointZ * pointWeight;
+			Lanes lengthSquared = dot(lightX, lightY, lightZ, lightX, lightY, lightZ);
+			// same as LightTable::attenuation
+			Lanes measuredSquared = lengthSquared;
+			if (not lights.uniformFade) {
+				Lanes measuredX = fadeSpace[0][0] * lightX + fadeSpace[1][0] * lightY
+				                  + fadeSpace[2][0] * lightZ;
+				Lanes measuredY = fadeSpace[0][1] * lightX + fadeSpace[1][1] * lightY
+				                  + fadeSpace[2][1] * lightZ;
+				Lanes measuredZ = fadeSpace[0][2] * lightX + fadeSpace[1][2] * lightY
+				                  + fadeSpace[2][2] * lightZ;
+				measuredSquared = dot(measuredX, measuredY, measuredZ, measuredX, measuredY,
+				                      measuredZ);
+			}
+			Lanes invRangeSquared = Lanes::fill(lights.invRangeSquared[light]);
+			Lanes fade = max(zero, one - measuredSquared * invRangeSquared);
+			if (maskBits(greater(fade, zero)) == 0) return; // out of range of every point
+			Lanes lightIntensity = Lanes::fill(lights.intensity[light]) * (fade * fade);
+			if (lights.shadows != NULL) {
+				// shadow maps are looked up one point at a time
+				alignas(32) real visible[Lanes::width];
+				for (int i = 0; i < Lanes::width; i++) {
+					rvec3 point{batch.pointX[lane + i], batch.pointY[lane + i],
+					            batch.pointZ[lane + i]};
+					visible[i] = lights.visibility(light, point);
+				}
+				lightIntensity = lightIntensity * Lanes::load(visible);
+			}
+			Lanes lightLength = sqrt(lengthSquared);
+			Lanes normalDotLightRaw = dot(normalX, normalY, normalZ, lightX, lightY, lightZ);
+
+			// diffuse, ignoring lights behind the surface
+			Lanes normalDotLight = normalDotLightRaw / lightLength;
+			Lanes diffuse = lightIntensity * normalDotLight / (normalLength * lightLength);
+			intensity = intensity + select(greater(normalDotLight, zero), diffuse, zero);
+
+			// specular: the reflected light, compared to the way out to the camera
+			Lanes twiceDot = normalDotLightRaw + normalDotLightRaw;
+			Lanes reflectedX = normalX * twiceDot - lightX;
+			Lanes reflectedY = normalY * twiceDot - lightY;
+			Lanes reflectedZ = normalZ * twiceDot - lightZ;
+			Lanes reflectedDotExit = zero
+			                         - dot(reflectedX, reflectedY, reflectedZ, camToPointX,
+			                               camToPointY, camToPointZ);
+			Lanes useSpecular = both(hasSpecular, greater(reflectedDotExit, zero));
+			int needsSpecular = maskBits(useSpecular);
+			if (needsSpecular == 0) return;
+
+			Lanes reflectedLength = sqrt(
+			    dot(reflectedX, reflectedY, reflectedZ, reflectedX, reflectedY, reflectedZ));
+			Lanes cosine = reflectedDotExit / (reflectedLength * camDistance);
+
+			if (sharedIntExponent) {
+				Lanes highlight = powInt(cosine, static_cast<uint>(exponents[0]));
+				intensity = intensity + select(useSpecular, lightIntensity * highlight, zero);
+				return;
+			}
+
+			// pow (or the table) doesn't vectorize, so it's done one lane at a time, only where
+			// it's needed
+			alignas(32) real cosines[Lanes::width];
+			alignas(32) real highlight[Lanes::width];
+			cosine.store(cosines);
+			for (int i = 0; i < Lanes::width; i++) {
+				const SpecularLut* table = batch.specularLut[lane + i];
+				if (not((needsSpecular >> i) & 1)) highlight[i] = 0;
+				else if (table != NULL) highlight[i] = table->at(cosines[i]);
+				else highlight[i] = pow(cosines[i], exponents[i]);
+			}
+			intensity = intensity + lightIntensity * Lanes::load(highlight);
+		});
+
+		min(intensity, Lanes::fill(1)).store(out + lane);
+	}
+}
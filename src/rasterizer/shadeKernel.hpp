@@ -0,0 +1,34 @@
+#ifndef SHADEKERNEL_HPP
+#define SHADEKERNEL_HPP
+#include "../extraAssertions.hpp"
+#include "../util/specularLut.hpp"
+#include "lightTable.hpp"
+#include "precision.hpp"
+
+// how many points computeLightingBatch lights at once
+constexpr int SHADE_BATCH = 8;
+
+// Up to SHADE_BATCH points to light, stored by field rather than by point.
+// Unused lanes are ignored, but still need to hold real numbers; call padBatch before lighting.
+struct LightingBatch {
+	int count = 0;
+	alignas(32) real pointX[SHADE_BATCH];
+	alignas(32) real pointY[SHADE_BATCH];
+	alignas(32) real pointZ[SHADE_BATCH];
+	alignas(32) real normalX[SHADE_BATCH]; // normalized
+	alignas(32) real normalY[SHADE_BATCH];
+	alignas(32) real normalZ[SHADE_BATCH];
+	alignas(32) real specular[SHADE_BATCH]; // -1 for none
+	const SpecularLut* specularLut[SHADE_BATCH]; // the table for specular, or NULL to use pow
+};
+
+// fills the unused lanes with copies of the first one
+void padBatch(LightingBatch& batch);
+
+// Same as computeLighting, for every point in the batch. out gets SHADE_BATCH values.
+// Only the lights in mask are used, or all of them if it's NULL.
+// Uses AVX2 when built with PLAY3D_SIMD, and a plain loop otherwise.
+void computeLightingBatch(const LightingBatch& batch, const rvec3 camera, const real ambientLight,
+                          const LightTable& lights, const LightMask* mask, real* out);
+
+#endif /* SHADEKERNEL_HPP */
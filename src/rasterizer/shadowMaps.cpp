@@ -0,0 +1,267 @@
+#include "shadowMaps.hpp"
+
+#include "tiledTriangles.hpp"
+
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// every instance's points and bounds in world space, shared by all the maps drawn in an update
+struct WorldCasters {
+	std::pmr::vector<rvec3> points;
+	std::pmr::vector<size_t> firstPoint; // where each instance's points start
+	std::pmr::vector<Sphere> bounds;
+
+	explicit WorldCasters(std::pmr::memory_resource* memory)
+	    : points(memory), firstPoint(memory), bounds(memory) {}
+};
+
+// a face looking along forward, as rows of right, up, and forward
+rmat4 faceBasis(const rvec3 forward) {
+	rvec3 up = std::abs(forward.y) > 0.99 ? rvec3{0, 0, 1} : rvec3{0, 1, 0};
+	rvec3 right = glm::normalize(glm::cross(up, forward));
+	up = glm::cross(forward, right);
+	return rmat4{glm::transpose(rmat3{right, up, forward})};
+}
+
+// the sides of a point light's 90 degree faces, and its near plane
+const std::vector<Plane> cubeFacePlanes{
+    {{0, 0, 1}, -SHADOW_NEAR},
+    {glm::normalize(rvec3{1, 0, 1}), 0},
+    {glm::normalize(rvec3{-1, 0, 1}), 0},
+    {glm::normalize(rvec3{0, 1, 1}), 0},
+    {glm::normalize(rvec3{0, -1, 1}), 0},
+};
+
+const rvec3 cubeFaceDirections[6]{{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                  {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+
+// Which sextant of a size by size map a point on its canvas (in sextants, origin at the center)
+// lands on, or false if it's off the map.
+bool sampleAt(const rvec2 canvasPoint, const int size, int& row, int& col) {
+	row = static_cast<int>(std::lround(size / 2 - canvasPoint.y));
+	col = static_cast<int>(std::lround(size / 2 + canvasPoint.x));
+	return 0 <= row and row < size and 0 <= col and col < size;
+}
+
+// Draws one instance's triangles into depths, from its points in the face's space. Triangles
+// crossing planes are clipped first. project gives a point's place on the canvas (in sextants)
+// and its nearness.
+// Both sides of every triangle are drawn, so meshes that aren't closed still cast shadows.
+template <typename Project>
+void drawCaster(DepthBuffer& depths, const Object3D& object, std::pmr::vector<rvec3>& points,
+                const std::vector<Plane>& planes, std::pmr::memory_resource* memory,
+                Project project) {
+	ClipBuffer clipped{points, memory};
+	std::pmr::vector<uint> unclipped{memory};
+	for (uint i = 0; i < object.getTriangles().size(); i++) {
+		const ColoredTriangle& triangle = object.getTriangles()[i];
+		Triangle<rvec3> vertices{points[triangle.triangle[0]], points[triangle.triangle[1]],
+		                         points[triangle.triangle[2]]};
+		switch (classifyTriangle(vertices, planes)) {
+		case PlaneSide::Inside: unclipped.push_back(i); break;
+		case PlaneSide::Outside: break;
+		case PlaneSide::Crossing: clipIntoBuffer(clipped, triangle, planes); break;
+		}
+	}
+
+	std::pmr::vector<ivec2> projected{memory};
+	std::pmr::vector<real> nearness{memory};
+	projected.reserve(points.size());
+	nearness.reserve(points.size());
+	for (const rvec3& point : points) {
+		auto [canvasPoint, near] = project(point);
+		projected.push_back(toSubpixel(canvasPoint));
+		nearness.push_back(near);
+	}
+
+	auto draw = [&](const Triangle<uint>& triangle) {
+		drawDepthTriangleTiled(
+		    depths, {projected[triangle[0]], projected[triangle[1]], projected[triangle[2]]},
+		    {nearness[triangle[0]], nearness[triangle[1]], nearness[triangle[2]]});
+	};
+	for (uint i : unclipped) draw(object.getTriangles()[i].triangle);
+	for (const ColoredTriangle& triangle : clipped.getTriangles()) draw(triangle.triangle);
+}
+
+// the instance's points moved by matrix, into points
+void casterPoints(const WorldCasters& world, const size_t instance, const size_t count,
+                  const rmat4& matrix, std::pmr::vector<rvec3>& points) {
+	points.clear();
+	for (size_t i = 0; i < count; i++) {
+		const rvec3& point = world.points[world.firstPoint[instance] + i];
+		points.push_back(canonicalize(matrix * toHomogenous(point)));
+	}
+}
+
+void drawDirectional(ShadowMap& map, const rvec3 towardsLight,
+                     const std::vector<InstanceRef3D>& instances, const WorldCasters& world,
+                     std::pmr::memory_resource* memory) {
+	if (map.faces.size() != 1) {
+		// depth buffers can't be assigned across sizes, so start over
+		map.faces.clear();
+		map.faces.resize(1, {rmat4{1}, DepthBuffer{SHADOW_MAP_SIZE, SHADOW_MAP_SIZE}});
+	}
+	ShadowFace& face = map.faces[0];
+	face.fromWorld = faceBasis(-glm::normalize(towardsLight));
+	face.depths.clear();
+	if (instances.empty()) return;
+
+	// the map covers every instance's bounds, as seen from the light
+	rvec3 low{std::numeric_limits<real>::infinity()};
+	rvec3 high{-std::numeric_limits<real>::infinity()};
+	for (const Sphere& bounds : world.bounds) {
+		Sphere seen = transformSphere(bounds, face.fromWorld);
+		low = glm::min(low, seen.center - seen.radius);
+		high = glm::max(high, seen.center + seen.radius);
+	}
+	map.center = (rvec2{low} + rvec2{high}) / static_cast<real>(2);
+	// a sextant short on each side, so nothing rounds off the edge
+	map.scale = (SHADOW_MAP_SIZE - 2) / std::max({high.x - low.x, high.y - low.y, real{0.001}});
+	map.far = high.z + 1; // so everything's nearness is at least 1, and never looks empty
+
+	std::pmr::vector<rvec3> points{memory};
+	for (size_t instance = 0; instance < instances.size(); instance++) {
+		const Object3D& object = instances[instance].getObject();
+		casterPoints(world, instance, object.getPoints().size(), face.fromWorld, points);
+		drawCaster(face.depths, object, points, {}, memory, [&](const rvec3 point) {
+			return std::pair{(rvec2{point} - map.center) * map.scale, map.far - point.z};
+		});
+	}
+}
+
+void drawPoint(ShadowMap& map, const rvec3 position, const real range,
+               const std::vector<InstanceRef3D>& instances, const WorldCasters& world,
+               std::pmr::memory_resource* memory) {
+	if (map.faces.size() != 6) {
+		// depth buffers can't be assigned across sizes, so start over
+		map.faces.clear();
+		map.faces.resize(6, {rmat4{1}, DepthBuffer{SHADOW_CUBE_SIZE, SHADOW_CUBE_SIZE}});
+	}
+	std::pmr::vector<rvec3> points{memory};
+	std::vector<Plane> crossedPlanes;
+	for (int faceIdx = 0; faceIdx < 6; faceIdx++) {
+		ShadowFace& face = map.faces[faceIdx];
+		face.fromWorld =
+		    faceBasis(cubeFaceDirections[faceIdx]) * glm::translate(rmat4{1}, -position);
+		face.depths.clear();
+
+		for (size_t instance = 0; instance < instances.size(); instance++) {
+			// anything out of the light's reach can't shade anything it lights
+			const Sphere& bounds = world.bounds[instance];
+			if (glm::distance(bounds.center, position) > range + bounds.radius) continue;
+
+			// same as renderInstance: skip it if it's outside the face, and only clip against
+			// the planes it crosses
+			Sphere seen = transformSphere(bounds, face.fromWorld);
+			crossedPlanes.clear();
+			bool outside = false;
+			for (const Plane& plane : cubeFacePlanes) {
+				real distance = signedDistance(plane, seen.center);
+				if (distance <= -seen.radius) outside = true;
+				if (distance < seen.radius) crossedPlanes.push_back(plane);
+			}
+			if (outside) continue;
+
+			const Object3D& object = instances[instance].getObject();
+			casterPoints(world, instance, object.getPoints().size(), face.fromWorld, points);
+			drawCaster(face.depths, object, points, crossedPlanes, memory, [](const rvec3 point) {
+				// clipping removes every triangle using a point this would break on
+				if (point.z < SHADOW_NEAR / 2) return std::pair{rvec2{0, 0}, real{0}};
+				return std::pair{rvec2{point} / point.z * static_cast<real>(SHADOW_CUBE_SIZE / 2),
+				                 1 / point.z};
+			});
+		}
+	}
+}
+} // namespace
+
+size_t ShadowMaps::update(const LightTable& lights, const std::vector<InstanceRef3D>& instances,
+                          std::pmr::memory_resource* memory) {
+	bool castersChanged = this->casters.size() != instances.size();
+	this->casters.resize(instances.size());
+	for (size_t instance = 0; instance < instances.size(); instance++) {
+		std::pair versions{instances[instance].getVersion(),
+		                   instances[instance].getObject().getVersion()};
+		castersChanged = castersChanged or this->casters[instance] != versions;
+		this->casters[instance] = versions;
+	}
+
+	if (this->maps.size() != lights.size()) {
+		ShadowMap never{};
+		std::fill_n(never.renderedFor, 5, std::numeric_limits<real>::quiet_NaN());
+		this->maps.resize(lights.size(), never);
+	}
+
+	WorldCasters world{memory};
+	bool worldReady = false;
+	size_t drawn = 0;
+	for (size_t light = 0; light < lights.size(); light++) {
+		ShadowMap& map = this->maps[light];
+		real current[5]{lights.x[light], lights.y[light], lights.z[light],
+		                lights.pointWeight[light], lights.range[light]};
+		// NaN never compares equal, so maps that were never drawn always are
+		if (not castersChanged and std::equal(current, current + 5, map.renderedFor)) continue;
+
+		if (not worldReady) {
+			for (const InstanceRef3D& instance : instances) {
+				world.firstPoint.push_back(world.points.size());
+				for (const rvec3& point : instance.getObject().getPoints()) {
+					world.points.push_back(
+					    canonicalize(instance.fromObjectSpace() * toHomogenous(point)));
+				}
+				world.bounds.push_back(
+				    transformSphere(instance.getBoundingSphere(), instance.fromObjectSpace()));
+			}
+			worldReady = true;
+		}
+
+		rvec3 vector{current[0], current[1], current[2]};
+		if (lights.isPoint(light))
+			drawPoint(map, vector, lights.range[light], instances, world, memory);
+		else
+			drawDirectional(map, vector, instances, world, memory);
+		std::copy_n(current, 5, map.renderedFor);
+		drawn++;
+	}
+	return drawn;
+}
+
+real ShadowMaps::visibility(const size_t light, const rvec3 point) const {
+	assertLt(light, this->maps.size(), "Light has no shadow map.");
+	const ShadowMap& map = this->maps[light];
+	int row, col;
+
+	if (map.faces.size() == 1) {
+		const ShadowFace& face = map.faces[0];
+		rvec3 seen = canonicalize(face.fromWorld * toHomogenous(point));
+		if (not sampleAt((rvec2{seen} - map.center) * map.scale, SHADOW_MAP_SIZE, row, col))
+			return 1; // nothing outside the scene's bounds casts anything
+		float stored = face.depths.get(row, col);
+		// a sextant and a half of slope, plus a bit, so surfaces don't shadow themselves
+		real bias = 1.5 / map.scale + 0.01;
+		return stored > map.far - seen.z + bias ? 0 : 1;
+	}
+
+	// the face is picked by the axis the point is furthest along from the light
+	rvec3 position{map.renderedFor[0], map.renderedFor[1], map.renderedFor[2]};
+	rvec3 fromLight = point - position;
+	rvec3 distances = glm::abs(fromLight);
+	int axis = distances.x >= distances.y and distances.x >= distances.z ? 0
+	           : distances.y >= distances.z                             ? 1
+	                                                                    : 2;
+	const ShadowFace& face = map.faces[axis * 2 + (fromLight[axis] < 0 ? 1 : 0)];
+	rvec3 seen = canonicalize(face.fromWorld * toHomogenous(point));
+	if (seen.z <= SHADOW_NEAR) return 1; // right at the light
+	if (not sampleAt(rvec2{seen} / seen.z * static_cast<real>(SHADOW_CUBE_SIZE / 2),
+	                 SHADOW_CUBE_SIZE, row, col))
+		return 1;
+	float stored = face.depths.get(row, col);
+	// sextants get bigger further from the light, so the bias does too
+	real bias = 3 * seen.z / SHADOW_CUBE_SIZE + 0.01;
+	return stored * (seen.z - bias) > 1 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#ifndef SHADOWMAPS_HPP
+#define SHADOWMAPS_HPP
+#include "../extraAssertions.hpp"
+#include "depthBuffer.hpp"
+#include "lightTable.hpp"
+#include "precision.hpp"
+#include "renderable.hpp"
+#include "structures.hpp"
+
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// sextants across (and down) a directional light's map
+constexpr int SHADOW_MAP_SIZE = 256;
+// sextants across (and down) each face of a point light's cube
+constexpr int SHADOW_CUBE_SIZE = 128;
+// nothing nearer to a point light than this casts a shadow
+constexpr real SHADOW_NEAR = 0.05;
+
+// One view of the scene from a light, drawn with the tiled engine. What's stored is nearness to
+// the light (bigger is closer, 0 is nothing), like the camera's depth buffer.
+struct ShadowFace {
+	rmat4 fromWorld; // into the face's space: x right, y up, and z away from the light
+	DepthBuffer depths;
+};
+
+struct ShadowMap {
+	// the light's x, y, z, pointWeight, and range when this was drawn; NaN if it never was
+	real renderedFor[5];
+	// Directional lights only: the part of the face's xy plane the map covers is centered on
+	// center, scale sextants to a unit. Nearness is far - z.
+	rvec2 center;
+	real scale;
+	real far;
+	std::vector<ShadowFace> faces; // one for directional lights, six (+x, -x, +y, ...) for points
+};
+
+// A shadow map for each of the scene's lights: an orthographic one covering the whole scene for
+// directional lights, and a cube around point lights.
+// Maps are kept between frames, and only drawn again once something about them changes. Any
+// instance or object changing redraws every map (shadows can fall anywhere), and a light moving
+// redraws its own.
+class ShadowMaps {
+  private:
+	std::vector<ShadowMap> maps; // same order as the lights
+	// every instance's version, and its object's, when the maps were last drawn
+	std::vector<std::pair<uint64_t, uint64_t>> casters;
+
+  public:
+	// Brings the maps up to date with lights (in world space) and the scene's instances.
+	// Geometry only lasts the call, and comes out of memory.
+	// @return how many maps were drawn
+	size_t update(const LightTable& lights, const std::vector<InstanceRef3D>& instances,
+	              std::pmr::memory_resource* memory);
+
+	// 1 if light (by its index in the table given to update) reaches point (in world space), 0
+	// if something's in the way
+	[[nodiscard]] real visibility(const size_t light, const rvec3 point) const;
+};
+
+#endif /* SHADOWMAPS_HPP */
@@ -3,16 +3,19 @@
 #include "renderable.hpp"
 #include "structures.hpp"
 
+#include <cmath>
+#include <numbers>
+
 // adds a point to the object, replacing a triangle with three new triangles
 // creates 2 more triangles (-1 +3), but does NOT delete the original triangle,
 // so the caller must then call clearEmptyTris
-void splitTriangle(Object3D& object, uint triangleIdx, dvec3 newPoint) {
+void splitTriangle(Object3D& object, uint triangleIdx, rvec3 newPoint) {
 	uint newIdx = object.addVertex(newPoint);
 	ColoredTriangle triangle = object.getTriangle(triangleIdx);
 	object.setTriangle(triangleIdx, NO_TRIANGLE);
 
-	dvec3 newVec =
-	    glm::normalize((triangle.normals[0] + triangle.normals[1] + triangle.normals[2]) / 3.);
+	// no need to average first, normalizing takes care of the length
+	rvec3 newVec = glm::normalize(triangle.normals[0] + triangle.normals[1] + triangle.normals[2]);
 
 	object.addTriangle({
 	    {triangle.triangle[0], triangle.triangle[1], newIdx},
@@ -47,15 +50,15 @@ void splitTriangle(Object3D& object, uint triangleIdx, dvec3 newPoint) {
 // approximate a sphere with an inscribed tetrahedron
 // more iterations == more triangles == more accurate
 // does not work
-Object3D makeSphere(Color color, double specular, double radius, uint iterations) {
+Object3D makeSphere(Color color, real specular, real radius, uint iterations) {
 	// points for a unit sphere
 	// these are also the normals,
 	// and can be scaled to form the points
-	std::array<dvec3, 4> points{
-	    dvec3{1,  1,  1 },
-        dvec3{-1, -1, 1 },
-        dvec3{-1, 1,  -1},
-        dvec3{1,  -1, -1}
+	std::array<rvec3, 4> points{
+	    rvec3{1,  1,  1 },
+        rvec3{-1, -1, 1 },
+        rvec3{-1, 1,  -1},
+        rvec3{1,  -1, -1}
     };
 	for (auto& point : points) {
 		point = glm::normalize(point);
@@ -81,20 +84,20 @@ Object3D makeSphere(Color color, double specular, double radius, uint iterations
 		// triangle count changes while iterating, so we have to store it here
 		uint triangleCount = sphere.getTriangles().size();
 		for (uint triangleIdx = 0; triangleIdx < triangleCount; triangleIdx++) {
-			Triangle<dvec3> trianglePoints{
+			Triangle<rvec3> trianglePoints{
 			    sphere.getPoint(sphere.getTriangle(triangleIdx).triangle[0]),
 			    sphere.getPoint(sphere.getTriangle(triangleIdx).triangle[1]),
 			    sphere.getPoint(sphere.getTriangle(triangleIdx).triangle[2])};
 
-			dvec3 triangleCenter{
+			rvec3 triangleCenter{
 			    // FIXME: I think this is wrong
 			    (trianglePoints[0].x + trianglePoints[1].x + trianglePoints[2].x) / 3.0,
 			    (trianglePoints[0].y + trianglePoints[1].y + trianglePoints[2].y) / 3.0,
 			    (trianglePoints[0].z + trianglePoints[1].z + trianglePoints[2].z) / 3.0};
 
-			assert((triangleCenter != dvec3{0, 0, 0}));
+			assert((triangleCenter != rvec3{0, 0, 0}));
 
-			dvec3 newPoint = triangleCenter * (radius / glm::length(triangleCenter));
+			rvec3 newPoint = triangleCenter * (radius / glm::length(triangleCenter));
 
 			splitTriangle(sphere, triangleIdx, newPoint);
 			// new triangles are placed at the end, so we don't have to handle those specially
@@ -102,7 +105,7 @@ Object3D makeSphere(Color color, double specular, double radius, uint iterations
 		sphere.clearEmptyTris();
 	}
 
-	for (const dvec3& i : sphere.getPoints()) {
+	for (const rvec3& i : sphere.getPoints()) {
 		assertBetweenIncl(radius - 0.1, glm::length(i), radius + 0.1,
 		                  "Sphere point is wrong length.");
 	}
@@ -116,6 +119,23 @@ Object3D makeSphere(Color color, double specular, double radius, uint iterations
 	return sphere;
 };
 
+// how many sextants a level of detail's triangles can each cover on screen before it's too coarse
+constexpr real LOD_TRIANGLE_AREA = 4;
+
+std::shared_ptr<Object3D> makeSphereWithLods(Color color, real specular, real radius,
+                                             uint iterations) {
+	auto sphere = std::make_shared<Object3D>(makeSphere(color, specular, radius, iterations));
+	for (uint level = iterations; level-- > 0;) {
+		// Every iteration triples the triangles, and about half of them face the camera. Those
+		// cover pi * r^2 sextants together, so this is the radius where each covers the limit.
+		real triangles = 4 * std::pow(3.0, level) / 2;
+		real maxRadius = std::sqrt(triangles * LOD_TRIANGLE_AREA / std::numbers::pi);
+		sphere->addLod(std::make_shared<Object3D>(makeSphere(color, specular, radius, level)),
+		               maxRadius);
+	}
+	return sphere;
+}
+
 // Add a square based pyramid to the supplied object.
 // baseCenter is the center of the pyramid's base
 // peakPoint is the location of the pointy end
@@ -127,12 +147,12 @@ Object3D makeSphere(Color color, double specular, double radius, uint iterations
 // +--*--* <-- baseSide
 //    ^-- baseCenter
 //
-void makePyramid(Object3D& object, const Color& color, const dvec3& baseCenter,
-                 const dvec3& peakPoint, const dvec3& baseSide) {
+void makePyramid(Object3D& object, const Color& color, const rvec3& baseCenter,
+                 const rvec3& peakPoint, const rvec3& baseSide) {
 	uint peakPointIdx = object.addVertex(peakPoint);
 
-	dvec3 baseSideOffset = baseSide - baseCenter;
-	dvec3 axis = peakPoint - baseCenter;
+	rvec3 baseSideOffset = baseSide - baseCenter;
+	rvec3 axis = peakPoint - baseCenter;
 
 	// verify axis and baseSideOffset are perpendicular
 	if (not(std::abs(glm::dot(axis, baseSideOffset)) <= 0.001)) {
@@ -140,7 +160,7 @@ void makePyramid(Object3D& object, const Color& color, const dvec3& baseCenter,
 		    "Base side, base center, and peak point must form a right triangle");
 	}
 
-	dvec3 offsetRot90 =
+	rvec3 offsetRot90 =
 	    glm::normalize(glm::cross(baseSideOffset, axis)) * glm::length(baseSideOffset);
 
 	// all four corners of the base
@@ -155,7 +175,7 @@ void makePyramid(Object3D& object, const Color& color, const dvec3& baseCenter,
 	for (uint i = 0; i < cornerIdxs.size(); i++) {
 		uint i2 = (i + 1) % cornerIdxs.size(); // the second vertex's index
 		// TODO: check this works
-		dvec3 normal = glm::normalize(glm::cross(object.getPoint(cornerIdxs[i2]) - peakPoint,
+		rvec3 normal = glm::normalize(glm::cross(object.getPoint(cornerIdxs[i2]) - peakPoint,
 		                                         object.getPoint(cornerIdxs[i]) - peakPoint));
 
 		object.addTriangle(ColoredTriangle{
@@ -165,7 +185,7 @@ void makePyramid(Object3D& object, const Color& color, const dvec3& baseCenter,
 	}
 
 	// base triangles
-	dvec3 baseNormal = glm::normalize(-axis);
+	rvec3 baseNormal = glm::normalize(-axis);
 	object.addTriangle(ColoredTriangle{
 	    {cornerIdxs[0], cornerIdxs[1], cornerIdxs[2]},
 	    color,
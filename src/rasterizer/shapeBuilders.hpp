@@ -5,14 +5,20 @@
 #include "structures.hpp"
 #include "../drawing/setColor.hpp"
 
-void splitTriangle(Object3D& object, uint triangleIdx, dvec3 newPoint);
+#include <memory>
 
-Object3D makeSphere(Color color, double specular, double radius, uint iterations);
+void splitTriangle(Object3D& object, uint triangleIdx, rvec3 newPoint);
+
+Object3D makeSphere(Color color, real specular, real radius, uint iterations);
+
+// makeSphere, with a level of detail for every smaller number of iterations
+std::shared_ptr<Object3D> makeSphereWithLods(Color color, real specular, real radius,
+                                             uint iterations);
 
 // join duplicated points, using tolerance as the threshold for points to join
-void combinePoints(Object3D& object, const double tolerance = 0.001);
+void combinePoints(Object3D& object, const real tolerance = 0.001);
 
-void makePyramid(Object3D& object, const Color& color, const dvec3& baseCenter,
-                 const dvec3& peakPoint, const dvec3& baseSide);
+void makePyramid(Object3D& object, const Color& color, const rvec3& baseCenter,
+                 const rvec3& peakPoint, const rvec3& baseSide);
 
 #endif /* SHAPEBUILDERS_HPP */
@@ -5,15 +5,21 @@
 
 #include <glm/matrix.hpp>
 
+#include <atomic>
 #include <csignal>
 
-dmat4 parseTransform(const Transform& transform) {
-	dmat4 scaleMatrix{1}; // identity matrix
+uint64_t newVersion() {
+	static std::atomic<uint64_t> last = 0;
+	return ++last;
+}
+
+rmat4 parseTransform(const Transform& transform) {
+	rmat4 scaleMatrix{1}; // identity matrix
 	scaleMatrix[0][0] = transform.scale.x;
 	scaleMatrix[1][1] = transform.scale.y;
 	scaleMatrix[2][2] = transform.scale.z;
 
-	dmat4 rotMatrix{1};
+	rmat4 rotMatrix{1};
 	for (int x = 0; x < 3; x++) {
 		for (int y = 0; y < 3; y++) {
 			rotMatrix[x][y] = transform.rotation[y][x];
@@ -22,7 +28,7 @@ dmat4 parseTransform(const Transform& transform) {
 		}
 	}
 
-	dmat4 translateMatrix{1};
+	rmat4 translateMatrix{1};
 	translateMatrix[3][0] = transform.translation.x;
 	translateMatrix[3][1] = transform.translation.y;
 	translateMatrix[3][2] = transform.translation.z;
@@ -35,7 +41,7 @@ dmat4 parseTransform(const Transform& transform) {
  * @brief Determine whether this matrix represents an affine transform or not.
  * @return true if this matrix is an affine transform, false if not.
  */
-bool isAffine(const dmat4& mat) {
+bool isAffine(const rmat4& mat) {
 	// First make sure the right row meets the condition that it is (0, 0, 0, 1)
 	if (mat[0][3] != 0 or mat[1][3] != 0 or mat[2][3] != 0 or mat[3][3] != 1) return false;
 
@@ -44,18 +50,18 @@ bool isAffine(const dmat4& mat) {
 	if (std::abs(glm::determinant(mat)) <= SMALL) return false;
 
 	// extract the translation
-	dvec3 translation4x4{mat[3][0], mat[3][1], mat[3][2]};
+	rvec3 translation4x4{mat[3][0], mat[3][1], mat[3][2]};
 
 	// Calculate the inverse and seperate the inverse translation component
 	// and the top 3x3 part of the inverse matrix
-	dmat4 inv4x4Matrix = glm::inverse(mat);
-	dvec3 inv4x4Translation{inv4x4Matrix[3][0], inv4x4Matrix[3][1], inv4x4Matrix[3][2]};
-	glm::dmat3 inv4x4Top3x3 = glm::dmat3(inv4x4Matrix);
+	rmat4 inv4x4Matrix = glm::inverse(mat);
+	rvec3 inv4x4Translation{inv4x4Matrix[3][0], inv4x4Matrix[3][1], inv4x4Matrix[3][2]};
+	rmat3 inv4x4Top3x3 = rmat3(inv4x4Matrix);
 
 	// Grab just the top 3x3 matrix
-	glm::dmat3 top3x3Matrix = glm::dmat3(mat);
-	glm::dmat3 invTop3x3Matrix = glm::inverse(top3x3Matrix);
-	dvec3 inv3x3Translation = -(invTop3x3Matrix * translation4x4);
+	rmat3 top3x3Matrix = rmat3(mat);
+	rmat3 invTop3x3Matrix = glm::inverse(top3x3Matrix);
+	rvec3 inv3x3Translation = -(invTop3x3Matrix * translation4x4);
 
 	// Make sure we adhere to the conditions of a 4x4 invertible affine transform matrix
 	return matCmp(inv4x4Top3x3, invTop3x3Matrix) and vecCmp(inv4x4Translation, inv3x3Translation);
@@ -66,11 +72,11 @@ bool isAffine(const dmat4& mat) {
  * @brief Decomposes the given matrix 'mat' into its translation, rotation and scale components.
  * @param mat The matrix to decompose.
  */
-Transform decompose(dmat4 mat) {
+Transform decompose(rmat4 mat) {
 	assertMsg(isAffine(mat), "Can't decompose a non-affine matrix.");
 
 	// Start by extracting the translation (and/or any projection) from the given matrix
-	dvec3 translation = {mat[3][0], mat[3][1], mat[3][2]};
+	rvec3 translation = {mat[3][0], mat[3][1], mat[3][2]};
 	for (int i = 0; i < 3; i++) {
 		mat[i][3] = 0.0;
 		mat[3][i] = 0.0;
@@ -80,12 +86,12 @@ Transform decompose(dmat4 mat) {
 	// Extract the rotation component - this is done using polar decompostion, where
 	// we successively average the matrix with its inverse transpose until there is
 	// no/a very small difference between successive averages
-	double norm;
+	real norm;
 	int count = 0;
-	dmat4 rotation = mat;
+	rmat4 rotation = mat;
 	do {
-		dmat4 nextRotation;
-		dmat4 currInvTranspose = glm::inverse(glm::transpose(rotation));
+		rmat4 nextRotation;
+		rmat4 currInvTranspose = glm::inverse(glm::transpose(rotation));
 
 		// Go through every component in the matrices and find the next matrix
 		for (int i = 0; i < 4; i++) {
@@ -96,27 +102,27 @@ Transform decompose(dmat4 mat) {
 
 		norm = 0.0;
 		for (int i = 0; i < 3; i++) {
-			double n = std::abs(rotation[i][0] - nextRotation[i][0])
-			           + std::abs(rotation[i][1] - nextRotation[i][1])
-			           + std::abs(rotation[i][2] - nextRotation[i][2]);
+			real n = std::abs(rotation[i][0] - nextRotation[i][0])
+			         + std::abs(rotation[i][1] - nextRotation[i][1])
+			         + std::abs(rotation[i][2] - nextRotation[i][2]);
 			norm = std::max(norm, n);
 		}
 		rotation = nextRotation;
 	} while (count < 100 && norm > SMALL);
 
 	// The scale is simply the removal of the rotation from the non-translated matrix
-	dmat4 scaleMatrix = glm::inverse(rotation) * mat;
-	dvec3 scale = dvec3{scaleMatrix[0][0], scaleMatrix[1][1], scaleMatrix[2][2]};
+	rmat4 scaleMatrix = glm::inverse(rotation) * mat;
+	rvec3 scale = rvec3{scaleMatrix[0][0], scaleMatrix[1][1], scaleMatrix[2][2]};
 
 	// Calculate the normalized rotation matrix and take its determinant to determine whether
 	// it had a negative scale or not...
-	dvec3 row1{mat[0][0], mat[0][1], mat[0][2]};
-	dvec3 row2{mat[1][0], mat[1][1], mat[1][2]};
-	dvec3 row3{mat[2][0], mat[2][1], mat[2][2]};
+	rvec3 row1{mat[0][0], mat[0][1], mat[0][2]};
+	rvec3 row2{mat[1][0], mat[1][1], mat[1][2]};
+	rvec3 row3{mat[2][0], mat[2][1], mat[2][2]};
 	row1 = glm::normalize(row1);
 	row2 = glm::normalize(row2);
 	row3 = glm::normalize(row3);
-	glm::dmat3 nRotation{row1, row2, row3};
+	rmat3 nRotation{row1, row2, row3};
 
 	// Special consideration: if there's a single negative scale
 	// (all other combinations of negative scales will
@@ -124,7 +130,7 @@ Transform decompose(dmat4 mat) {
 	// normalized rotation matrix will be < 0.
 	// If this is the case we apply an arbitrary negative to one
 	// of the component of the scale.
-	double determinant = glm::determinant(nRotation);
+	real determinant = glm::determinant(nRotation);
 	if (determinant < 0) scale.x *= -1;
 
 	// std::println(std::cerr, "rot:{}", rotation);
@@ -139,15 +145,17 @@ Transform invertTransform(const Transform& transform) {
     };
 }
 
-std::vector<Plane> Camera::getClippingPlanes() const {
+std::vector<Plane> Camera::getClippingPlanes(const real guardBand) const {
+	real width = this->viewportWidth * guardBand;
+	real height = this->viewportHeight * guardBand;
 	return {
 	    // four planes that define the "cone" of clipping
 	    // no, the width/height and distance are not swapped, they are supposed to be this way
-	    {glm::normalize(dvec3{this->viewportDistance, 0, this->viewportWidth}),   0                             },
-	    {glm::normalize(dvec3{-this->viewportDistance, 0, this->viewportWidth}),  0                             },
-	    {glm::normalize(dvec3{0, this->viewportDistance, this->viewportHeight}),  0                             },
-	    {glm::normalize(dvec3{0, -this->viewportDistance, this->viewportHeight}), 0                             },
+	    {glm::normalize(rvec3{this->viewportDistance, 0, width}),   0},
+	    {glm::normalize(rvec3{-this->viewportDistance, 0, width}),  0},
+	    {glm::normalize(rvec3{0, this->viewportDistance, height}),  0},
+	    {glm::normalize(rvec3{0, -this->viewportDistance, height}), 0},
 	    // for the viewport
-	    {{0, 0, 1},	                                                           this->viewportDistance + SMALL}
+	    {{0, 0, 1},	                                                           this->viewportDistance + (real)SMALL}
     };
 }
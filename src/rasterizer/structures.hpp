@@ -4,12 +4,11 @@
 #include "glm/gtx/dual_quaternion.hpp"
 #include "glm/gtx/string_cast.hpp"
 #include "../drawing/setColor.hpp"
+#include "precision.hpp"
 
-#include <glm/ext/matrix_double4x4.hpp>
-#include <glm/ext/vector_double3.hpp>
-#include <glm/ext/vector_double4.hpp>
 #include <glm/ext/vector_int2.hpp>
 
+#include <cstdint>
 #include <vector>
 
 #define cwhite Color(Category(true, 8), RGBA(255, 255, 255, 255))
@@ -21,15 +20,18 @@
 #define ccyan Color(Category(true, 8), RGBA(0, 255, 255, 255))
 #define cblack Color(Category(true, 8), RGBA(0, 0, 0, 255))
 
-using glm::dvec3, glm::dvec4, glm::ivec2, glm::dmat4;
+using glm::ivec2;
 
-#define origin \
-	dvec3 { \
-		0, 0, 0 \
-	}
+// not a macro, so headers included after this one (like boost's, which has origin() members)
+// still parse
+inline const rvec3 origin{0, 0, 0};
 
 extern bool debugFrame;
 
+// A number no other call has returned, for telling whether something changed since it was last
+// looked at. Never 0, so that can mean "nothing yet". Thread safe.
+uint64_t newVersion();
+
 template <typename T> using Triangle = std::array<T, 3>;
 
 // applies lambda to each element of tri and discards the return value
@@ -73,42 +75,54 @@ inline Triangle<T> forAllPairsRet(const Triangle<T> tri, const LambdaType lambda
 
 // I would use NaN instead of infinity, but the equality nonsense is annoying
 #define NO_POINT \
-	dvec3 { \
-		std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), \
-		    std::numeric_limits<double>::infinity() \
+	rvec3 { \
+		std::numeric_limits<real>::infinity(), std::numeric_limits<real>::infinity(), \
+		    std::numeric_limits<real>::infinity() \
 	}
 
 struct ColoredTriangle {
 	Triangle<uint> triangle; // refers to array indexes
 	Color color;
-	Triangle<dvec3> normals;
+	Triangle<rvec3> normals;
 
 	bool operator==(const ColoredTriangle& other) const = default;
 	bool operator!=(const ColoredTriangle& other) const = default;
 };
 
 struct Sphere {
-	dvec3 center;
-	double radius;
+	rvec3 center;
+	real radius;
+};
+
+// axis aligned, bounds inclusive
+struct BoundingBox {
+	rvec3 min;
+	rvec3 max;
+};
+
+// a box turned any which way: its center, and half of each side, along the box's own axes
+struct OrientedBox {
+	rvec3 center;
+	rvec3 halfSides[3];
 };
 
 struct Plane {
-	dvec3 normal;
-	double distance; // distance from origin
+	rvec3 normal;
+	real distance; // distance from origin
 };
 
 struct Transform {
-	dvec3 translation;
-	glm::dmat3 rotation;
-	dvec3 scale; // x, y, and z scale
+	rvec3 translation;
+	rmat3 rotation;
+	rvec3 scale; // x, y, and z scale
 
-	Transform(const dvec3 translation, const glm::dmat3 rotation, const dvec3 scale)
+	Transform(const rvec3 translation, const rmat3 rotation, const rvec3 scale)
 	    : translation(translation), rotation(rotation), scale(scale) {}
 
-	Transform(const dvec3 translation, const glm::dmat3 rotation, const double scale)
+	Transform(const rvec3 translation, const rmat3 rotation, const real scale)
 	    : translation(translation), rotation(rotation), scale(scale, scale, scale) {}
 
-	Transform() : Transform({0, 0, 0}, glm::dmat3(1 /* identity matrix */), 1.0) {}
+	Transform() : Transform({0, 0, 0}, rmat3(1 /* identity matrix */), 1.0) {}
 };
 
 template <> struct std::formatter<Transform> : std::formatter<string> {
@@ -121,23 +135,23 @@ template <> struct std::formatter<Transform> : std::formatter<string> {
 	}
 };
 
-dmat4 parseTransform(const Transform& transform);
+rmat4 parseTransform(const Transform& transform);
 
-bool isAffine(const dmat4& mat);
-Transform decompose(dmat4 mat);
+bool isAffine(const rmat4& mat);
+Transform decompose(rmat4 mat);
 
 struct MatAndTranslation {
-	glm::dmat3 rotation; // also includes scaled
-	dvec3 translation;
+	rmat3 rotation; // also includes scaled
+	rvec3 translation;
 };
 
 // Much cheaper that full decompose.
 // Keeps the rotation and scale together.
-inline MatAndTranslation partialDecompose(const dmat4& mat) {
+inline MatAndTranslation partialDecompose(const rmat4& mat) {
 	assertMsg(isAffine(mat), "Can't decompose a non-affine matrix.");
 
-	dvec3 translation = {mat[3][0], mat[3][1], mat[3][2]};
-	glm::dmat3 rotation = mat; // just crop outside the top left 3x3
+	rvec3 translation = {mat[3][0], mat[3][1], mat[3][2]};
+	rmat3 rotation = mat; // just crop outside the top left 3x3
 
 	return {rotation, translation};
 }
@@ -146,22 +160,23 @@ Transform invertTransform(const Transform& transform);
 
 class Camera {
   private:
-	dmat4 invTransform;
-	dmat4 matTransform;
+	rmat4 invTransform;
+	rmat4 matTransform;
+	uint64_t version = newVersion(); // changes with the transform (not the viewport)
 
   public:
-	double viewportWidth;
-	double viewportHeight;
-	double viewportDistance;
+	real viewportWidth;
+	real viewportHeight;
+	real viewportDistance;
 
-	Camera(double viewportWidth, double viewportHeight, double viewportDistance)
-	    : invTransform(glm::identity<dmat4>()), matTransform(glm::identity<dmat4>()),
+	Camera(real viewportWidth, real viewportHeight, real viewportDistance)
+	    : invTransform(glm::identity<rmat4>()), matTransform(glm::identity<rmat4>()),
 	      viewportWidth(viewportWidth), viewportHeight(viewportHeight),
 	      viewportDistance(viewportDistance) {}
 
 	// converts a point in camera space to a point on the viewport
-	glm::dmat3x4 viewportTransform(const ivec2 canvasSize) const {
-		glm::dmat3x4 matrix{1};
+	rmat3x4 viewportTransform(const ivec2 canvasSize) const {
+		rmat3x4 matrix{1};
 		matrix[0][0] = viewportDistance * canvasSize.x / viewportWidth;
 		matrix[1][1] = viewportDistance * canvasSize.y / viewportHeight;
 		return matrix;
@@ -172,22 +187,28 @@ class Camera {
 	void setTransform(const Transform& transform) {
 		this->invTransform = parseTransform(invertTransform(transform));
 		this->matTransform = parseTransform(transform);
+		this->version = newVersion();
 	}
 
 	// Do not invert -- this will do that by itself.
 	void translateBy(const Transform& transform) {
 		this->invTransform = parseTransform(invertTransform(transform)) * this->invTransform;
 		this->matTransform = glm::inverse(this->invTransform);
+		this->version = newVersion();
 	}
 
+	uint64_t getVersion() const { return this->version; }
+
 	// quite slow, so don't call often
 	const Transform getTransform() { return decompose(this->matTransform); }
 
-	const dmat4& toCameraSpace() const { return this->invTransform; }
+	const rmat4& toCameraSpace() const { return this->invTransform; }
 
-	const dmat4& fromCameraSpace() const { return this->matTransform; }
+	const rmat4& fromCameraSpace() const { return this->matTransform; }
 
-	std::vector<Plane> getClippingPlanes() const;
+	// The four sides of the view, then the viewport. guardBand widens the sides, to that many
+	// times the view's width and height.
+	std::vector<Plane> getClippingPlanes(const real guardBand = 1) const;
 };
 
 #endif /* STRUCTURES_HPP */
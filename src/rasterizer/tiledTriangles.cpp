@@ -0,0 +1,284 @@
+#include "tiledTriangles.hpp"
+
+#include "structures.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// E(p) = a * col + b * row + c, exact since the vertices are fixed point
+// zero on the edge, positive on the inside once the triangle is wound the right way
+struct EdgeFunction {
+	int64_t a; // change per column
+	int64_t b; // change per row
+	int64_t c;
+
+	int64_t at(const int64_t col, const int64_t row) const { return a * col + b * row + c; }
+};
+
+// The edge going from p0 to p1, both in subpixels.
+// a and b are scaled up so the function can be evaluated at whole sextants.
+static EdgeFunction makeEdge(const ivec2 p0, const ivec2 p1) {
+	int64_t a = -(p1.y - p0.y);
+	int64_t b = p1.x - p0.x;
+	return {a * SUBPIXEL_SCALE, b * SUBPIXEL_SCALE, -(a * p0.x + b * p0.y)};
+}
+
+// Top-left rule: a sextant exactly on an edge belongs to the triangle only if it's a top edge
+// (horizontal, with the inside below) or a left edge (the inside to its right). Two triangles
+// sharing an edge see it from opposite sides, so exactly one of them draws it.
+// The inside must already be positive.
+static bool isTopLeft(const EdgeFunction& edge) {
+	// buffer coordinates have y going down
+	return edge.a > 0 or (edge.a == 0 and edge.b > 0);
+}
+
+// an attribute that varies linearly across the triangle (in screen space)
+struct AttributePlane {
+	real dCol; // change per column
+	real dRow; // change per row
+	real base; // value at (0, 0)
+
+	real at(const int col, const int row) const { return base + dCol * col + dRow * row; }
+};
+
+// edges[i] must be the edge opposite vertex i, so edges[i] / area is vertex i's barycentric weight
+static AttributePlane makePlane(const Triangle<EdgeFunction>& edges, const int64_t area,
+                                const Triangle<real>& values) {
+	AttributePlane plane{0, 0, 0};
+	for (uint i = 0; i < 3; i++) {
+		plane.dCol += values[i] * edges[i].a;
+		plane.dRow += values[i] * edges[i].b;
+		plane.base += values[i] * edges[i].c;
+	}
+	plane.dCol /= area;
+	plane.dRow /= area;
+	plane.base /= area;
+	return plane;
+}
+
+// Converts points (in subpixels) to buffer coordinates in verts, and sets up the edges between
+// them with the inside positive. False if the triangle covers no area.
+// The edges still include sextants exactly on them; call applyTopLeft once any planes are made.
+static bool makeEdges(const Triangle<ivec2>& points, const ivec2 canvasSize,
+                      Triangle<ivec2>& verts, Triangle<EdgeFunction>& edges, int64_t& area) {
+	// work in buffer coordinates (origin at top left, y down) from here on, still in subpixels
+	for (uint i = 0; i < 3; i++) {
+		verts[i] = {canvasSize.x / 2 * SUBPIXEL_SCALE + points[i].x,
+		            canvasSize.y / 2 * SUBPIXEL_SCALE - points[i].y};
+	}
+
+	edges = {makeEdge(verts[1], verts[2]), makeEdge(verts[2], verts[0]),
+	         makeEdge(verts[0], verts[1])};
+	// twice the area (in subpixels), which is edges[2] at verts[2]
+	area = (int64_t)(verts[1].x - verts[0].x) * (verts[2].y - verts[0].y)
+	       - (int64_t)(verts[1].y - verts[0].y) * (verts[2].x - verts[0].x);
+
+	// Degenerate triangles cover no area. The scanline engine still draws them as a line, but
+	// they're always side on to the camera, so they'd be culled anyways.
+	if (area == 0) return false;
+	// flip counterclockwise triangles so the inside is always positive
+	if (area < 0) {
+		for (EdgeFunction& edge : edges) {
+			edge = {-edge.a, -edge.b, -edge.c};
+		}
+		area = -area;
+	}
+	return true;
+}
+
+// Edge values are whole numbers, so taking one off makes >= 0 act like > 0 and leaves the
+// sextants exactly on the edge out. Done after the planes so it doesn't shift attributes.
+static void applyTopLeft(Triangle<EdgeFunction>& edges) {
+	for (EdgeFunction& edge : edges) {
+		if (not isTopLeft(edge)) edge.c -= 1;
+	}
+}
+
+// the sextants inside the bounding box of verts (in buffer subpixels, rounding inwards), clipped
+// to the scissor
+static ScreenRect coveredRect(const Triangle<ivec2>& verts, const ScreenRect& scissor) {
+	auto [minX, maxX] = std::minmax({verts[0].x, verts[1].x, verts[2].x});
+	auto [minY, maxY] = std::minmax({verts[0].y, verts[1].y, verts[2].y});
+	return {std::max(scissor.minRow, ceilSubpixel(minY)),
+	        std::max(scissor.minCol, ceilSubpixel(minX)),
+	        std::min(scissor.maxRow, maxY >> SUBPIXEL_BITS),
+	        std::min(scissor.maxCol, maxX >> SUBPIXEL_BITS)};
+}
+
+enum class TileCoverage { Outside, Partial, Full };
+
+// edge functions are linear, so checking the corners is enough
+static TileCoverage classifyTile(const Triangle<EdgeFunction>& edges, const int minCol,
+                                 const int minRow, const int maxCol, const int maxRow) {
+	TileCoverage coverage = TileCoverage::Full;
+	for (const EdgeFunction& edge : edges) {
+		std::array corners{edge.at(minCol, minRow), edge.at(maxCol, minRow),
+		                   edge.at(minCol, maxRow), edge.at(maxCol, maxRow)};
+		if (*std::max_element(ALL_OF(corners)) < 0) return TileCoverage::Outside;
+		if (*std::min_element(ALL_OF(corners)) < 0) coverage = TileCoverage::Partial;
+	}
+	return coverage;
+}
+
+void drawFilledTriangleTiled(SextantDrawing& canvas, DepthBuffer& depthBuffer,
+                             const RenderSettings& settings, const ScreenRect& scissor,
+                             const Triangle<ivec2>& points,
+                             const Triangle<float>& depth, const Triangle<rvec3>& normals,
+                             const Triangle<real>& lighting, const TriangleShading& shading) {
+	const ivec2 canvasSize = shading.canvasSize;
+
+	Triangle<ivec2> verts;
+	Triangle<EdgeFunction> edges;
+	int64_t area;
+	if (not makeEdges(points, canvasSize, verts, edges, area)) return;
+
+	if (debugFrame)
+		std::println(std::cerr, "drawing tiled tri: {}", points);
+
+	Triangle<real> invDepths{1 / static_cast<real>(depth[0]), 1 / static_cast<real>(depth[1]),
+	                         1 / static_cast<real>(depth[2])};
+	real maxInvDepth = *std::max_element(ALL_OF(invDepths));
+	AttributePlane invDepthPlane = makePlane(edges, area, invDepths);
+	AttributePlane normalXPlane = makePlane(edges, area, {normals[0].x, normals[1].x, normals[2].x});
+	AttributePlane normalYPlane = makePlane(edges, area, {normals[0].y, normals[1].y, normals[2].y});
+	AttributePlane normalZPlane = makePlane(edges, area, {normals[0].z, normals[1].z, normals[2].z});
+	AttributePlane lightingPlane = makePlane(edges, area, lighting);
+	applyTopLeft(edges);
+
+	auto [minRow, minCol, maxRow, maxCol] = coveredRect(verts, scissor);
+	if (minCol > maxCol or minRow > maxRow) return; // fully outside
+
+	FragmentBatch batch;
+
+	// tiles are aligned to the canvas, not the triangle
+	for (int tileRow = minRow - minRow % TILE_SIZE; tileRow <= maxRow; tileRow += TILE_SIZE) {
+		for (int tileCol = minCol - minCol % TILE_SIZE; tileCol <= maxCol; tileCol += TILE_SIZE) {
+			// the part of the tile inside the bounding box
+			int startCol = std::max(tileCol, minCol);
+			int startRow = std::max(tileRow, minRow);
+			int endCol = std::min(tileCol + TILE_SIZE - 1, maxCol);
+			int endRow = std::min(tileRow + TILE_SIZE - 1, maxRow);
+
+			TileCoverage coverage = classifyTile(edges, startCol, startRow, endCol, endRow);
+			if (coverage == TileCoverage::Outside) continue;
+
+			// depth is linear too, so its extremes over the tile are at the corners
+			std::array cornerDepths{
+			    invDepthPlane.at(startCol, startRow), invDepthPlane.at(endCol, startRow),
+			    invDepthPlane.at(startCol, endRow), invDepthPlane.at(endCol, endRow)};
+			bool skipDepthTest = false;
+			if (settings.hierarchicalZ) {
+				// corners outside the triangle can overshoot, so cap at the nearest vertex
+				real nearest = std::min(*std::max_element(ALL_OF(cornerDepths)), maxInvDepth);
+				if (depthBuffer.rectHidden(startRow, startCol, endRow, endCol, nearest)) continue;
+				// the corners are only real depths if the triangle covers them
+				skipDepthTest = coverage == TileCoverage::Full
+				                and depthBuffer.rectInFront(
+				                    startRow, startCol, endRow, endCol,
+				                    *std::min_element(ALL_OF(cornerDepths)));
+			}
+
+			for (int row = startRow; row <= endRow; row++) {
+				// step everything incrementally across the row
+				Triangle<int64_t> edgeVals{edges[0].at(startCol, row), edges[1].at(startCol, row),
+				                           edges[2].at(startCol, row)};
+				real invDepth = invDepthPlane.at(startCol, row);
+				rvec3 normal{normalXPlane.at(startCol, row), normalYPlane.at(startCol, row),
+				             normalZPlane.at(startCol, row)};
+				real interpLighting = lightingPlane.at(startCol, row);
+
+				for (int col = startCol; col <= endCol; col++) {
+					bool inside = coverage == TileCoverage::Full
+					              or (edgeVals[0] >= 0 and edgeVals[1] >= 0 and edgeVals[2] >= 0);
+
+					if (inside and (skipDepthTest or depthBuffer.get(row, col) < invDepth)) {
+						ivec2 pos{col - canvasSize.x / 2, canvasSize.y / 2 - row};
+						depthBuffer.set(row, col, invDepth);
+						writeFragment(canvas, batch, row, col, pos, invDepth, normal,
+						              interpLighting, shading);
+					}
+
+					for (uint i = 0; i < 3; i++) {
+						edgeVals[i] += edges[i].a;
+					}
+					invDepth += invDepthPlane.dCol;
+					normal += rvec3{normalXPlane.dCol, normalYPlane.dCol, normalZPlane.dCol};
+					interpLighting += lightingPlane.dCol;
+				}
+			}
+		}
+	}
+
+	flushFragments(canvas, batch, shading);
+}
+
+void drawDepthTriangleTiled(DepthBuffer& depthBuffer, const Triangle<ivec2>& points,
+                            const Triangle<real>& nearness) {
+	const ivec2 canvasSize{depthBuffer.getWidth(), depthBuffer.getHeight()};
+	Triangle<ivec2> verts;
+	Triangle<EdgeFunction> edges;
+	int64_t area;
+	if (not makeEdges(points, canvasSize, verts, edges, area)) return;
+	AttributePlane nearnessPlane = makePlane(edges, area, nearness);
+	applyTopLeft(edges);
+
+	ScreenRect whole{0, 0, canvasSize.y - 1, canvasSize.x - 1};
+	auto [minRow, minCol, maxRow, maxCol] = coveredRect(verts, whole);
+
+	// nothing's shaded, so there's no need for tiles; just test every sextant in the box
+	for (int row = minRow; row <= maxRow; row++) {
+		Triangle<int64_t> edgeVals{edges[0].at(minCol, row), edges[1].at(minCol, row),
+		                           edges[2].at(minCol, row)};
+		real value = nearnessPlane.at(minCol, row);
+		for (int col = minCol; col <= maxCol; col++) {
+			if (edgeVals[0] >= 0 and edgeVals[1] >= 0 and edgeVals[2] >= 0
+			    and depthBuffer.get(row, col) < value)
+				depthBuffer.set(row, col, value);
+
+			for (uint i = 0; i < 3; i++) {
+				edgeVals[i] += edges[i].a;
+			}
+			value += nearnessPlane.dCol;
+		}
+	}
+}
+
+void drawOccluderTriangleTiled(DepthBuffer& coarse, const int scale, const ivec2 canvasSize,
+                               const Triangle<ivec2>& points, const Triangle<real>& nearness) {
+	Triangle<ivec2> verts;
+	Triangle<EdgeFunction> edges;
+	int64_t area;
+	if (not makeEdges(points, canvasSize, verts, edges, area)) return;
+	AttributePlane nearnessPlane = makePlane(edges, area, nearness);
+
+	ScreenRect whole{0, 0, canvasSize.y - 1, canvasSize.x - 1};
+	auto [minRow, minCol, maxRow, maxCol] = coveredRect(verts, whole);
+	if (minCol > maxCol or minRow > maxRow) return;
+
+	for (int cellRow = minRow / scale; cellRow <= maxRow / scale; cellRow++) {
+		int top = cellRow * scale;
+		int bottom = std::min(top + scale - 1, canvasSize.y - 1);
+		for (int cellCol = minCol / scale; cellCol <= maxCol / scale; cellCol++) {
+			int left = cellCol * scale;
+			int right = std::min(left + scale - 1, canvasSize.x - 1);
+
+			// The triangle's convex, so it covers every sextant in the cell if it covers the
+			// corners. Strictly inside, so the top-left rule can't leave one out. Nearness is
+			// the same plane drawFilledTriangleTiled draws, so the corners have the farthest of it
+			// too.
+			bool covered = true;
+			real farthest = std::numeric_limits<real>::infinity();
+			for (int row : {top, bottom}) {
+				for (int col : {left, right}) {
+					for (const EdgeFunction& edge : edges) {
+						covered = covered and edge.at(col, row) > 0;
+					}
+					farthest = std::min(farthest, nearnessPlane.at(col, row));
+				}
+			}
+			if (covered and coarse.get(cellRow, cellCol) < farthest)
+				coarse.set(cellRow, cellCol, farthest);
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef TILEDTRIANGLES_HPP
+#define TILEDTRIANGLES_HPP
+#include "../drawing/sextantBlocks.hpp"
+#include "depthBuffer.hpp"
+#include "settings.hpp"
+#include "triangles.hpp"
+
+#include <glm/ext/vector_int2.hpp>
+
+// Fills a triangle using edge functions instead of walking its sides.
+// Whole tiles are accepted or rejected at once, and only tiles on the triangle's edges get a
+// per-pixel coverage test. Attributes are set up once per triangle as plane equations, so nothing
+// here allocates.
+// Coverage is tested exactly, in fixed point at the vertices' subpixel precision, with a top-left
+// rule: sextants on an edge shared by two triangles are drawn (and shaded) by only one of them.
+// points are in subpixels.
+void drawFilledTriangleTiled(SextantDrawing& canvas, DepthBuffer& depthBuffer,
+                             const RenderSettings& settings, const ScreenRect& scissor,
+                             const Triangle<ivec2>& points,
+                             const Triangle<float>& depth, const Triangle<rvec3>& normals,
+                             const Triangle<real>& lighting, const TriangleShading& shading);
+
+// Only writes depth, for shadow maps: wherever the triangle covers (by the same rules as above),
+// nearness is interpolated linearly and kept if it's nearer than what's in depthBuffer. The
+// canvas is the size of the buffer, and points are in subpixels on it.
+void drawDepthTriangleTiled(DepthBuffer& depthBuffer, const Triangle<ivec2>& points,
+                            const Triangle<real>& nearness);
+
+// drawOccluderTriangle (see triangles.hpp) for triangles this engine draws. points are in
+// subpixels.
+void drawOccluderTriangleTiled(DepthBuffer& coarse, const int scale, const ivec2 canvasSize,
+                               const Triangle<ivec2>& points, const Triangle<real>& nearness);
+
+#endif /* TILEDTRIANGLES_HPP */
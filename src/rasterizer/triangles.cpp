@@ -1,55 +1,40 @@
 #include "triangles.hpp"
 
+#include "depthBuffer.hpp"
 #include "glm/ext/quaternion_geometric.hpp"
 #include "glm/geometric.hpp"
 #include "glm/gtx/string_cast.hpp"
 #include "interpolate.hpp"
 #include "renderable.hpp"
 #include "structures.hpp"
+#include "tiledTriangles.hpp"
 
-#include <boost/multi_array.hpp>
-
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <memory>
 
-// converts from origin at center to origin at top left
-template <typename T>
-inline void putBufPixel(boost::multi_array<T, 2>& buffer, const ivec2 coord, const T val) {
-	ivec2 transformed = {buffer.shape()[0] / 2 - coord.y, buffer.shape()[1] / 2 + coord.x};
-	if (0 <= transformed.y and transformed.y < (int)buffer.shape()[0] and 0 <= transformed.x
-	    and transformed.x < (int)buffer.shape()[1])
-		buffer[transformed.y][transformed.x] = val;
-}
-
-// converts from origin at center to origin at top left
-template <typename T>
-inline T getBufPixel(const boost::multi_array<T, 2>& buffer, const ivec2 coord, const T fallback) {
-	ivec2 transformed = {buffer.shape()[0] / 2 - coord.y, buffer.shape()[1] / 2 + coord.x};
-	if (0 <= transformed.y and transformed.y < (int)buffer.shape()[0] and 0 <= transformed.x
-	    and transformed.x < (int)buffer.shape()[1])
-		return buffer[transformed.y][transformed.x];
-	return fallback;
-}
-
-static dvec3 reflectRay(const dvec3 ray, const dvec3 around) {
-	return around * glm::dot(around, ray) * 2.0 - ray;
+static rvec3 reflectRay(const rvec3 ray, const rvec3 around) {
+	return 2 * glm::dot(around, ray) * around - ray;
 }
 
-static double computeLighting(const dvec3 point, const dvec3 camera, const dvec3 normal,
-                              const double specular, const double ambientLight,
-                              const std::vector<std::shared_ptr<Light>> lights) {
+real computeLighting(const rvec3 point, const rvec3 camera, const rvec3 normal,
+                     const real specular, const real ambientLight,
+                     const LightTable& lights, const SpecularLut* specularLut) {
 	assertFiniteVec(point, "");
 	assertFiniteVec(camera, "");
 	assertFiniteVec(normal, "");
 	assertFinite(specular, "");
 	assertFinite(ambientLight, "");
 
-	double intensity = ambientLight;
-	dvec3 camToPoint = point - camera;
+	real intensity = ambientLight;
+	rvec3 camToPoint = point - camera;
 
-	for (const std::shared_ptr<const Light> light : lights) {
-		dvec3 lightDir = light->getDirection(point);
+	for (size_t light = 0; light < lights.size(); light++) {
+		rvec3 lightDir = lights.getDirection(light, point);
+		real lightIntensity = lights.intensity[light] * lights.attenuation(light, lightDir);
+		if (lightIntensity != 0) lightIntensity *= lights.visibility(light, point);
+		if (lightIntensity == 0) continue; // out of range, or just dark
 
 		if (debugFrame) {
 			std::print(std::cerr, "[light from vec {:.2f}:", lightDir);
@@ -60,10 +45,10 @@ static double computeLighting(const dvec3 point, const dvec3 camera, const dvec3
 		}
 
 		// diffuse
-		double normalDotLight = glm::dot(normal, glm::normalize(lightDir));
+		real normalDotLight = glm::dot(normal, glm::normalize(lightDir));
 		if (debugFrame) std::print(std::cerr, "ndl:{:.2f}, ", normalDotLight);
 		if (normalDotLight > 0) { // ignore lights behind the surface
-			intensity += (light->getIntensity() * normalDotLight)
+			intensity += (lightIntensity * normalDotLight)
 			             / (glm::length(normal) * glm::length(lightDir));
 			if (debugFrame) std::print(std::cerr, "intensity diffuse:{:.2f}, ", intensity);
 		} else if (debugFrame) {
@@ -72,13 +57,13 @@ static double computeLighting(const dvec3 point, const dvec3 camera, const dvec3
 
 		// specular
 		if (specular != -1) {
-			dvec3 reflected = reflectRay(lightDir, normal);
-			double reflectedDotExit = glm::dot(reflected, -camToPoint);
+			rvec3 reflected = reflectRay(lightDir, normal);
+			real reflectedDotExit = glm::dot(reflected, -camToPoint);
 			if (reflectedDotExit > 0) {
-				intensity +=
-				    light->getIntensity()
-				    * pow(reflectedDotExit / (glm::length(reflected) * glm::length(camToPoint)),
-				          specular);
+				real cosine = reflectedDotExit / (glm::length(reflected) * glm::length(camToPoint));
+				real highlight =
+				    specularLut != NULL ? specularLut->at(cosine) : pow(cosine, specular);
+				intensity += lightIntensity * highlight;
 				if (debugFrame) {
 					std::print(std::cerr, "rde:{:.2f}, ", reflectedDotExit);
 					std::print(std::cerr, "reflected:{:.2f}, ", reflected);
@@ -95,26 +80,108 @@ static double computeLighting(const dvec3 point, const dvec3 camera, const dvec3
 		if (debugFrame) std::print(std::cerr, "], ");
 	}
 
-	return std::min(intensity, 1.0);
+	return std::min<real>(intensity, 1);
 }
 
-void drawLine(SextantDrawing& canvas, ivec2 p0, ivec2 p1, const Color color) {
-	if (std::abs(p0.x - p1.x) > std::abs(p0.y - p1.y)) { // line is horizontalish
-		if (p0.x > p1.x) // make sure p0 is left of p1
-			std::swap(p0, p1);
+rvec3 fragmentCamPosition(const ivec2 pos, const real invDepth, const TriangleShading& shading) {
+	const Camera& camera = shading.camera;
+	rvec3 viewportPoint{pos.x * camera.viewportWidth / shading.canvasSize.x,
+	                    pos.y * camera.viewportHeight / shading.canvasSize.y,
+	                    camera.viewportDistance};
+
+	real depth = 1. / invDepth;
+	real scaleFactor = depth / glm::length(viewportPoint);
+	// because the camera is at {0, 0, 0},
+	// the camera to point vector is the same as the point itself
+	rvec3 camToDrawnPoint{viewportPoint.x * scaleFactor, viewportPoint.y * scaleFactor,
+	                      0 /* set to a placeholder */};
+	camToDrawnPoint.z = sqrt(pow(depth, 2) - pow(camToDrawnPoint.x, 2) - pow(camToDrawnPoint.y, 2));
+	return camToDrawnPoint;
+}
 
-		std::vector<double> yVals = interpolate(p0.x, p0.y, p1.x, p1.y);
-		for (int x = p0.x; x <= p1.x; x++) {
-			putPixel(canvas, SextantCoord(yVals.at(x - p0.x), x), color);
-		}
-	} else { // line is verticalish
-		if (p0.y > p1.y) // make sure p0 is under p1
-			std::swap(p0, p1);
+Color shadeFragment(const ivec2 pos, const real invDepth, const rvec3 interpNormal,
+                    const TriangleShading& shading) {
+	if (debugFrame) std::print(std::cerr, "pixel ({}, {}): ", pos.x, pos.y);
+
+	real depth = 1. / invDepth;
+	rvec3 camToDrawnPoint = fragmentCamPosition(pos, invDepth, shading);
+
+	// lit in camera space, so the camera is at the origin
+	rvec3 normal = glm::normalize(shading.normalToCam * interpNormal);
+	real lighting = computeLighting(camToDrawnPoint, origin, normal, shading.specular,
+	                                shading.ambientLight, shading.lights, shading.specularLut);
 
-		std::vector<double> xVals = interpolate(p0.y, p0.x, p1.y, p1.x);
-		for (int y = p0.y; y <= p1.y; y++) {
-			putPixel(canvas, SextantCoord(y, xVals.at(y - p0.y)), color);
+	// #ifndef NDEBUG
+	//				ivec2 reversed = canonicalize(toHomogenous(camToDrawnPoint)
+	//				                              *
+	// camera.viewportTransform(canvasSize));
+	// assertEq(glm::to_string(reversed), glm::to_string(ivec2{x, y}),
+	//"Reversed does not match."); #endif
+
+	if (debugFrame)
+		std::println(std::cerr,
+		             "normal: {:.2f}, cam to point: {:.2f}, depth: {:.2f}, lighting: {:.2f}",
+		             normal, camToDrawnPoint, depth, lighting);
+
+	return Color(shading.color.category, shading.color.color * lighting);
+}
+
+void flushFragments(SextantDrawing& canvas, FragmentBatch& batch, const TriangleShading& shading) {
+	if (batch.count == 0) return;
+
+	// the one at a time path prints everything it does
+	if (debugFrame) {
+		for (int i = 0; i < batch.count; i++) {
+			canvas.set(SextantCoord(batch.rows[i], batch.cols[i]),
+			           shadeFragment(batch.positions[i], batch.invDepths[i], batch.normals[i],
+			                         shading));
 		}
+		batch.count = 0;
+		return;
+	}
+
+	const Camera& camera = shading.camera;
+	real viewportScaleX = camera.viewportWidth / shading.canvasSize.x;
+	real viewportScaleY = camera.viewportHeight / shading.canvasSize.y;
+
+	LightingBatch lighting;
+	lighting.count = batch.count;
+	for (int i = 0; i < batch.count; i++) {
+		// same as fragmentCamPosition, but scaling the viewport point all at once
+		rvec3 viewportPoint{batch.positions[i].x * viewportScaleX,
+		                    batch.positions[i].y * viewportScaleY, camera.viewportDistance};
+		rvec3 camPoint = viewportPoint / (batch.invDepths[i] * glm::length(viewportPoint));
+		rvec3 normal = glm::normalize(shading.normalToCam * batch.normals[i]);
+
+		lighting.pointX[i] = camPoint.x;
+		lighting.pointY[i] = camPoint.y;
+		lighting.pointZ[i] = camPoint.z;
+		lighting.normalX[i] = normal.x;
+		lighting.normalY[i] = normal.y;
+		lighting.normalZ[i] = normal.z;
+		lighting.specular[i] = shading.specular;
+		lighting.specularLut[i] = shading.specularLut;
+	}
+	padBatch(lighting);
+
+	LightMask mask;
+	if (shading.lightGrid != NULL)
+		shading.lightGrid->gather(batch.rows, batch.cols, batch.invDepths, batch.count, mask);
+
+	real intensities[SHADE_BATCH];
+	computeLightingBatch(lighting, origin, shading.ambientLight,
+	                     shading.lights, shading.lightGrid != NULL ? &mask : NULL, intensities);
+	for (int i = 0; i < batch.count; i++) {
+		canvas.set(SextantCoord(batch.rows[i], batch.cols[i]),
+		           Color(shading.color.category, shading.color.color * intensities[i]));
+	}
+
+	batch.count = 0;
+}
+
+void drawLine(SextantDrawing& canvas, ivec2 p0, ivec2 p1, const Color color) {
+	for (ivec2 point : LineDda(p0, p1)) {
+		putPixel(canvas, SextantCoord(point.y, point.x), color);
 	}
 }
 
@@ -125,189 +192,358 @@ void drawWireframeTriangle(SextantDrawing& canvas, const ivec2 p0, const ivec2 p
 	drawLine(canvas, p2, p0, color);
 }
 
-// interpolated on the y axis
-struct InterpElems {
-	double x; // x value (duh)
-	double invDepth; // 1 / depth
-	double normalX; // interpolate x, y, and z of the normal vector
-	double normalY;
-	double normalZ;
-};
-
-// interpolated for each row (the x-axis)
-struct RowElems {
-	double invDepth; // 1 / depth
-	double normalX; // interpolate x, y, and z of the normal vector
-	double normalY;
-	double normalZ;
+// fields interpolated on the y axis (down the edges)
+enum EdgeField {
+	EDGE_X,
+	EDGE_INV_DEPTH,
+	EDGE_NORMAL_X,
+	EDGE_NORMAL_Y,
+	EDGE_NORMAL_Z,
+	EDGE_LIGHTING
 };
+typedef FieldInterpolator<6> EdgeInterpolator;
+
+// fields interpolated for each row (the x-axis)
+enum RowField { ROW_INV_DEPTH, ROW_NORMAL_X, ROW_NORMAL_Y, ROW_NORMAL_Z, ROW_LIGHTING };
+typedef FieldInterpolator<5> RowInterpolator;
+
+static EdgeInterpolator makeEdgeInterpolator(const ivec2 p0, const real invDepth0,
+                                             const rvec3 normal0, const real lighting0,
+                                             const ivec2 p1, const real invDepth1,
+                                             const rvec3 normal1, const real lighting1) {
+	return EdgeInterpolator(
+	    p0.y, {static_cast<double>(p0.x), invDepth0, normal0.x, normal0.y, normal0.z, lighting0},
+	    p1.y, {static_cast<double>(p1.x), invDepth1, normal1.x, normal1.y, normal1.z, lighting1});
+}
 
-// this function is a mess
-void drawFilledTriangle(SextantDrawing& canvas, boost::multi_array<float, 2>& depthBuffer,
-                        Triangle<ivec2> points, Triangle<float> depth, Triangle<dvec3> normals,
-                        const Color color, const double ambientLight, const double specular,
-                        const Camera& camera, const dmat4& camToObj,
-                        const std::vector<std::shared_ptr<Light>>& lights) {
+void drawFilledTriangle(SextantDrawing& canvas, DepthBuffer& depthBuffer,
+                        const RenderSettings& settings, const ScreenRect& scissor,
+                        Triangle<ivec2> points, Triangle<float> depth, Triangle<rvec3> normals,
+                        Triangle<real> lighting, const TriangleShading& shading) {
 	// sort top to bottom, so p0.y < p1.y < p2.y
 	// we don't care about ordering clockwise anymore, so this is fine
 	if (points[1].y < points[0].y) {
 		std::swap(depth[1], depth[0]);
 		std::swap(points[1], points[0]);
 		std::swap(normals[1], normals[0]);
+		std::swap(lighting[1], lighting[0]);
 	}
 	if (points[2].y < points[0].y) {
 		std::swap(depth[2], depth[0]);
 		std::swap(points[2], points[0]);
 		std::swap(normals[2], normals[0]);
+		std::swap(lighting[2], lighting[0]);
 	}
 	if (points[2].y < points[1].y) {
 		std::swap(depth[2], depth[1]);
 		std::swap(points[2], points[1]);
 		std::swap(normals[2], normals[1]);
+		std::swap(lighting[2], lighting[1]);
 	}
 
-	ivec2 canvasSize{canvas.getWidth(), canvas.getHeight()};
-
-	dvec3 camPosInObjCoords = canonicalize(camToObj * toHomogenous(origin));
 	if (debugFrame)
-		std::println(std::cerr, "drawing tri: {}, cam @ {:.2f}", points, camPosInObjCoords);
-
-		// easier syntax
-#define interpField(vec, field, x0, y0, x1, y1) \
-	do { \
-		interpolateField<decltype(vec)::value_type>((vec), &decltype(vec)::value_type::field, \
-		                                            (x0), (y0), (x1), (y1)); \
-	} while (false)
-
-	std::vector<InterpElems> shortSide1{
-	    static_cast<uint>(points[1].y - points[0].y + 1), InterpElems{0, 0, 0, 0, 0}
-    };
-	interpField(shortSide1, x, points[0].y, points[0].x, points[1].y, points[1].x);
-	interpField(shortSide1, invDepth, points[0].y, 1.0 / depth[0], points[1].y, 1.0 / depth[1]);
-	interpField(shortSide1, normalX, points[0].y, normals[0].x, points[1].y, normals[1].x);
-	interpField(shortSide1, normalY, points[0].y, normals[0].y, points[1].y, normals[1].y);
-	interpField(shortSide1, normalZ, points[0].y, normals[0].z, points[1].y, normals[1].z);
-
-	std::vector<InterpElems> shortSide2{
-	    static_cast<uint>(points[2].y - points[1].y + 1), InterpElems{0, 0, 0, 0, 0}
-    };
-	interpField(shortSide2, x, points[1].y, points[1].x, points[2].y, points[2].x);
-	interpField(shortSide2, invDepth, points[1].y, 1.0 / depth[1], points[2].y, 1.0 / depth[2]);
-	interpField(shortSide2, normalX, points[1].y, normals[1].x, points[2].y, normals[2].x);
-	interpField(shortSide2, normalY, points[1].y, normals[1].y, points[2].y, normals[2].y);
-	interpField(shortSide2, normalZ, points[1].y, normals[1].z, points[2].y, normals[2].z);
-
-	std::vector<InterpElems> longSide{
-	    static_cast<uint>(points[2].y - points[0].y + 1), InterpElems{0, 0, 0, 0, 0}
-    };
-	interpField(longSide, x, points[0].y, points[0].x, points[2].y, points[2].x);
-	interpField(longSide, invDepth, points[0].y, 1.0 / depth[0], points[2].y, 1.0 / depth[2]);
-	interpField(longSide, normalX, points[0].y, normals[0].x, points[2].y, normals[2].x);
-	interpField(longSide, normalY, points[0].y, normals[0].y, points[2].y, normals[2].y);
-	interpField(longSide, normalZ, points[0].y, normals[0].z, points[2].y, normals[2].z);
-
-	// combine vectors
-	shortSide1.pop_back();
-	// from here, shortSide1 is actually both short sides combined
-	shortSide1.reserve(shortSide1.size() + shortSide2.size());
-	// TODO: don't actually copy here, use boost::join() or something
-	shortSide1.insert(shortSide1.end(), shortSide2.begin(), shortSide2.end());
-
-	std::unique_ptr<std::vector<InterpElems>> left;
-	std::unique_ptr<std::vector<InterpElems>> right;
-	int middleIndex = longSide.size() / 2; // some arbitrary index
-	if (longSide.at(middleIndex).x == shortSide1.at(middleIndex).x and middleIndex != 0)
-		middleIndex--; // fix problems if length==2
-
-	if (longSide.at(middleIndex).x < shortSide1.at(middleIndex).x) {
-		left = std::make_unique<std::vector<InterpElems>>(longSide);
-		right = std::make_unique<std::vector<InterpElems>>(shortSide1);
-	} else {
-		left = std::make_unique<std::vector<InterpElems>>(shortSide1);
-		right = std::make_unique<std::vector<InterpElems>>(longSide);
-	}
+		std::println(std::cerr, "drawing tri: {}", points);
+
+	Triangle<real> invDepths{1 / static_cast<real>(depth[0]), 1 / static_cast<real>(depth[1]),
+	                         1 / static_cast<real>(depth[2])};
+
+	// the short sides are walked one after the other, switching over at points[1]
+	EdgeInterpolator longSide = makeEdgeInterpolator(points[0], invDepths[0], normals[0],
+	                                                 lighting[0], points[2], invDepths[2],
+	                                                 normals[2], lighting[2]);
+	EdgeInterpolator shortSide = makeEdgeInterpolator(points[0], invDepths[0], normals[0],
+	                                                  lighting[0], points[1], invDepths[1],
+	                                                  normals[1], lighting[1]);
+
+	// The long side is on the left if it passes left of the middle point.
+	// Checking there (rather than at some arbitrary row) can't be confused by the two sides
+	// meeting at a vertex.
+	real longXAtMiddle = points[2].y == points[0].y
+	                         ? points[0].x
+	                         : interpolateValue(points[0].y, points[0].x, points[2].y,
+	                                            points[2].x, points[1].y);
+	bool longIsLeft = longXAtMiddle < points[1].x;
+
+	FragmentBatch batch;
 
 	for (int y = points[0].y; y <= points[2].y; y++) {
-		InterpElems rowLeft = left->at(y - points[0].y);
-		InterpElems rowRight = right->at(y - points[0].y);
-		int rowLeftX = round(rowLeft.x);
-		int rowRightX = round(rowRight.x);
+		if (y == points[1].y) // switch to the second short side
+			shortSide = makeEdgeInterpolator(points[1], invDepths[1], normals[1], lighting[1],
+			                                 points[2], invDepths[2], normals[2], lighting[2]);
+
+		// Rows off the canvas still have to be stepped through, so the edges get to the same
+		// values they would have, but needn't be walked. Guard-band clipping leaves plenty.
+		int bufferRow = canvas.getHeight() / 2 - y;
+		if (bufferRow < scissor.minRow) break; // rows only go up from here
+		if (scissor.maxRow < bufferRow) {
+			longSide.step();
+			shortSide.step();
+			continue;
+		}
+
+		const EdgeInterpolator& left = longIsLeft ? longSide : shortSide;
+		const EdgeInterpolator& right = longIsLeft ? shortSide : longSide;
+		int rowLeftX = round(left[EDGE_X]);
+		int rowRightX = round(right[EDGE_X]);
 		assertGtEq(rowRightX, rowLeftX, "right is left of left");
 
-		std::vector<RowElems> row{
-		    static_cast<uint>(rowRightX - rowLeftX + 1), RowElems{0, 0, 0, 0}
+		RowInterpolator row{
+		    rowLeftX,
+		    {left[EDGE_INV_DEPTH], left[EDGE_NORMAL_X], left[EDGE_NORMAL_Y], left[EDGE_NORMAL_Z],
+		     left[EDGE_LIGHTING]},
+		    rowRightX,
+		    {right[EDGE_INV_DEPTH], right[EDGE_NORMAL_X], right[EDGE_NORMAL_Y],
+		     right[EDGE_NORMAL_Z], right[EDGE_LIGHTING]}
         };
 
-		interpField(row, invDepth, rowLeftX, rowLeft.invDepth, rowRightX, rowRight.invDepth);
-		interpField(row, normalX, rowLeftX, rowLeft.normalX, rowRightX, rowRight.normalX);
-		interpField(row, normalY, rowLeftX, rowLeft.normalY, rowRightX, rowRight.normalY);
-		interpField(row, normalZ, rowLeftX, rowLeft.normalZ, rowRightX, rowRight.normalZ);
-
-		for (int x = rowLeftX; x <= rowRightX; x++) {
-			RowElems pixel = row.at(x - rowLeftX);
-			double invDepth = pixel.invDepth;
-			if (getBufPixel(depthBuffer, {x, y}, std::numeric_limits<float>::infinity())
-			    < invDepth) {
-				if (debugFrame) std::print(std::cerr, "pixel ({}, {}): ", x, y);
-
-				dvec3 viewportPoint{x * camera.viewportWidth / canvasSize.x,
-				                    y * camera.viewportHeight / canvasSize.y,
-				                    camera.viewportDistance};
-
-				double depth = 1. / invDepth;
-				double scaleFactor = depth / glm::length(viewportPoint);
-				// because the camera is at {0, 0, 0},
-				// the camera to point vector is the same as the point itself
-				dvec3 camToDrawnPoint{viewportPoint.x * scaleFactor, viewportPoint.y * scaleFactor,
-				                      0 /* set to a placeholder */};
-				camToDrawnPoint.z =
-				    sqrt(pow(depth, 2) - pow(camToDrawnPoint.x, 2) - pow(camToDrawnPoint.y, 2));
-
-				// point in object-relative coordinates
-				dvec3 pointObj = canonicalize(camToObj * toHomogenous(camToDrawnPoint));
-				if (debugFrame) std::print(std::cerr, "pointObj:{:.2f}, ", pointObj);
-
-				dvec3 normal = glm::normalize(dvec3{pixel.normalX, pixel.normalY, pixel.normalZ});
-				double lighting = computeLighting(pointObj, camPosInObjCoords, normal, specular,
-				                                  ambientLight, lights);
-				RGBA newColor = color.color * lighting;
-
-				// #ifndef NDEBUG
-				//				ivec2 reversed = canonicalize(toHomogenous(camToDrawnPoint)
-				//				                              *
-				// camera.viewportTransform(canvasSize));
-				// assertEq(glm::to_string(reversed), glm::to_string(ivec2{x, y}),
-				//"Reversed does not match."); #endif
-
-				if (debugFrame)
-					std::println(
-					    std::cerr,
-					    "normal: {:.2f}, cam to point: {:.2f}, depth: {:.2f}, lighting: {:.2f}",
-					    normal, camToDrawnPoint, depth, lighting);
-
-				putBufPixel(depthBuffer, {x, y}, (float)invDepth);
-				putPixel(canvas, SextantCoord(y, x), Color(color.category, newColor));
+		// Only walk the part of the row inside the scissor. Every span below starts with a seek, so
+		// where the scissor cuts the row doesn't change any of the values.
+		int startX = std::max(rowLeftX, scissor.minCol - canvas.getWidth() / 2);
+		int endX = std::min(rowRightX, scissor.maxCol - canvas.getWidth() / 2);
+
+		real rowSlope = rowLeftX == rowRightX ? 0
+		                                      : (right[EDGE_INV_DEPTH] - left[EDGE_INV_DEPTH])
+		                                            / (rowRightX - rowLeftX);
+
+		for (int x = startX; x <= endX;) {
+			int col = canvas.getWidth() / 2 + x;
+			// the rest of the row that's in this tile
+			int spanEndX = std::min(endX, x + TILE_SIZE - 1 - col % TILE_SIZE);
+			row.seek(x - rowLeftX);
+
+			if (settings.hierarchicalZ) {
+				real spanNearest = std::max(row[ROW_INV_DEPTH],
+				                            row[ROW_INV_DEPTH] + rowSlope * (spanEndX - x));
+				if (depthBuffer.rectHidden(bufferRow, col, bufferRow, col + spanEndX - x,
+				                           spanNearest)) {
+					x = spanEndX + 1;
+					continue;
+				}
+			}
+
+			for (; x <= spanEndX; x++, col++, row.step()) {
+				real invDepth = row[ROW_INV_DEPTH];
+				if (depthBuffer.get(bufferRow, col) < invDepth) {
+					depthBuffer.set(bufferRow, col, invDepth);
+					writeFragment(canvas, batch, bufferRow, col, {x, y}, invDepth,
+					              {row[ROW_NORMAL_X], row[ROW_NORMAL_Y], row[ROW_NORMAL_Z]},
+					              row[ROW_LIGHTING], shading);
+				}
 			}
 		}
+
+		longSide.step();
+		shortSide.step();
 	}
-#undef interpField
+
+	flushFragments(canvas, batch, shading);
 }
 
-void renderTriangle(SextantDrawing& canvas, boost::multi_array<float, 2>& depthBuffer,
+// most rows a cell of drawOccluderTriangle's can have
+constexpr int MAX_CELL_ROWS = 16;
+
+// one row of a triangle, the way drawFilledTriangle walks it
+struct ScanlineRow {
+	int leftX; // drawn from here to rightX (inclusive), in canvas coordinates
+	int rightX;
+	double leftInvDepth; // at leftX
+	double rightInvDepth; // at rightX
+
+	// what drawFilledTriangle draws at x, worked out the same way
+	real invDepthAt(const int x) const {
+		FieldInterpolator<1> row{this->leftX, {this->leftInvDepth}, this->rightX,
+		                         {this->rightInvDepth}};
+		row.seek(x - this->leftX);
+		return row[0];
+	}
+};
+
+// drawOccluderTriangle for drawFilledTriangle. That rounds x along the triangle's sides and
+// interpolates between the rounded ends, so the sides and nearness are walked the same way here,
+// rather than tested against the exact triangle.
+// points are in whole sextants.
+static void drawOccluderTriangleScanline(DepthBuffer& coarse, const int scale,
+                                         const ivec2 canvasSize, Triangle<ivec2> points,
+                                         Triangle<real> nearness) {
+	assertLtEq(scale, MAX_CELL_ROWS, "Occlusion cells are too tall.");
+	// sort top to bottom, exactly like drawFilledTriangle
+	if (points[1].y < points[0].y) {
+		std::swap(nearness[1], nearness[0]);
+		std::swap(points[1], points[0]);
+	}
+	if (points[2].y < points[0].y) {
+		std::swap(nearness[2], nearness[0]);
+		std::swap(points[2], points[0]);
+	}
+	if (points[2].y < points[1].y) {
+		std::swap(nearness[2], nearness[1]);
+		std::swap(points[2], points[1]);
+	}
+
+	EdgeInterpolator longSide = makeEdgeInterpolator(points[0], nearness[0], {}, 0, points[2],
+	                                                 nearness[2], {}, 0);
+	EdgeInterpolator shortSide = makeEdgeInterpolator(points[0], nearness[0], {}, 0, points[1],
+	                                                  nearness[1], {}, 0);
+	real longXAtMiddle = points[2].y == points[0].y
+	                         ? points[0].x
+	                         : interpolateValue(points[0].y, points[0].x, points[2].y,
+	                                            points[2].x, points[1].y);
+	bool longIsLeft = longXAtMiddle < points[1].x;
+
+	// the rows walked so far in cellRow
+	std::array<ScanlineRow, MAX_CELL_ROWS> rows;
+	int rowCount = 0;
+	int cellRow = -1;
+	auto markCells = [&]() {
+		// a cell's only covered if every one of its rows is
+		if (cellRow < 0 or rowCount < std::min(scale, canvasSize.y - cellRow * scale)) return;
+		int leftX = std::numeric_limits<int>::min();
+		int rightX = std::numeric_limits<int>::max();
+		for (int i = 0; i < rowCount; i++) {
+			leftX = std::max(leftX, rows[i].leftX);
+			rightX = std::min(rightX, rows[i].rightX);
+		}
+		int minCol = std::max(canvasSize.x / 2 + leftX, 0);
+		int maxCol = std::min(canvasSize.x / 2 + rightX, canvasSize.x - 1);
+
+		for (int cellCol = (minCol + scale - 1) / scale; cellCol * scale <= maxCol; cellCol++) {
+			int left = cellCol * scale;
+			int right = std::min(left + scale - 1, canvasSize.x - 1);
+			if (right > maxCol) break;
+			// nearness is linear along each row, so the ends have the farthest of it
+			real farthest = std::numeric_limits<real>::infinity();
+			for (int i = 0; i < rowCount; i++) {
+				farthest = std::min({farthest, rows[i].invDepthAt(left - canvasSize.x / 2),
+				                     rows[i].invDepthAt(right - canvasSize.x / 2)});
+			}
+			if (coarse.get(cellRow, cellCol) < farthest) coarse.set(cellRow, cellCol, farthest);
+		}
+	};
+
+	for (int y = points[0].y; y <= points[2].y; y++) {
+		if (y == points[1].y) // switch to the second short side
+			shortSide = makeEdgeInterpolator(points[1], nearness[1], {}, 0, points[2],
+			                                 nearness[2], {}, 0);
+
+		int bufferRow = canvasSize.y / 2 - y;
+		if (bufferRow < 0) break; // rows only go up from here
+		if (bufferRow < canvasSize.y) {
+			if (bufferRow / scale != cellRow) {
+				markCells();
+				cellRow = bufferRow / scale;
+				rowCount = 0;
+			}
+			const EdgeInterpolator& left = longIsLeft ? longSide : shortSide;
+			const EdgeInterpolator& right = longIsLeft ? shortSide : longSide;
+			rows[rowCount++] = {static_cast<int>(round(left[EDGE_X])),
+			                    static_cast<int>(round(right[EDGE_X])), left[EDGE_INV_DEPTH],
+			                    right[EDGE_INV_DEPTH]};
+		}
+
+		longSide.step();
+		shortSide.step();
+	}
+	markCells();
+}
+
+ScreenRect subpixelBounds(const Triangle<ivec2>& points, const ivec2 canvasSize) {
+	auto [minX, maxX] = std::minmax({points[0].x, points[1].x, points[2].x});
+	auto [minY, maxY] = std::minmax({points[0].y, points[1].y, points[2].y});
+	// rounding outwards covers the scanline engine's rounded vertices too
+	return {canvasSize.y / 2 - ceilSubpixel(maxY), canvasSize.x / 2 + (minX >> SUBPIXEL_BITS),
+	        canvasSize.y / 2 - (minY >> SUBPIXEL_BITS), canvasSize.x / 2 + ceilSubpixel(maxX)};
+}
+
+bool sphereBounds(const Sphere& bounds, const Camera& camera, const ivec2 canvasSize,
+                  ScreenRect& out) {
+	const rvec3& center = bounds.center;
+	real radius = bounds.radius;
+	if (center.z - radius <= camera.viewportDistance) return false;
+
+	// X/Z and Y/Z are monotonic over the sphere's bounding box when Z > 0, so the corners of the
+	// box give a (loose) projected bounding rectangle
+	rvec3 scale = camera.viewportTransform(canvasSize) * rvec4{1, 1, 1, 1};
+	real minX = std::numeric_limits<real>::infinity(), maxX = -minX;
+	real minY = minX, maxY = -minX;
+	for (real dx : {-radius, radius}) {
+		for (real dz : {-radius, radius}) {
+			real x = scale.x * (center.x + dx) / (center.z + dz);
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+		}
+	}
+	for (real dy : {-radius, radius}) {
+		for (real dz : {-radius, radius}) {
+			real y = scale.y * (center.y + dy) / (center.z + dz);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+		}
+	}
+
+	// to buffer coordinates (y is flipped), rounding outwards
+	out.minCol = canvasSize.x / 2 + static_cast<int>(std::floor(minX));
+	out.maxCol = canvasSize.x / 2 + static_cast<int>(std::ceil(maxX));
+	out.minRow = canvasSize.y / 2 - static_cast<int>(std::ceil(maxY));
+	out.maxRow = canvasSize.y / 2 - static_cast<int>(std::floor(minY));
+	return true;
+}
+
+void renderTriangle(SextantDrawing& canvas, DepthBuffer& depthBuffer, GBuffer* gBuffer,
+                    const RenderSettings& settings, const ScreenRect& scissor,
                     const Triangle<ivec2>& triangle, const Triangle<float>& depth,
-                    const Triangle<dvec3> normals, const Color color, const double ambientLight,
-                    const double specular, const Camera& camera, const dmat4& camToObj,
-                    const std::vector<std::shared_ptr<Light>> lights) {
-	// randomize colors so tris can be distinguished
-	Color color2 = color;
-	if (debugFrame) {
-		color2 = Color{
-		    color.category,
-		    {static_cast<uchar>(rand() % 255), static_cast<uchar>(rand() % 255),
-		               static_cast<uchar>(rand() % 255), 255}
-        };
+                    const Triangle<rvec3> normals, const Triangle<real>& lighting,
+                    const Color color, const Camera& camera, const InstanceShading& instance) {
+	// throw out triangles that are behind everything before doing any setup for them
+	if (settings.hierarchicalZ) {
+		// depth is interpolated linearly, so nothing in the triangle is nearer than its vertices
+		float nearest = 1.0f / std::min({depth[0], depth[1], depth[2]});
+		// kept inside the scissor
+		ScreenRect bounds = subpixelBounds(triangle, {canvas.getWidth(), canvas.getHeight()});
+		if (depthBuffer.rectHidden(
+		        std::max(scissor.minRow, bounds.minRow), std::max(scissor.minCol, bounds.minCol),
+		        std::min(scissor.maxRow, bounds.maxRow), std::min(scissor.maxCol, bounds.maxCol),
+		        nearest))
+			return;
 	}
 
-	drawFilledTriangle(canvas, depthBuffer, triangle, depth, normals, color2, ambientLight,
-	                   specular, camera, camToObj, lights);
+	TriangleShading shading{color,
+	                        instance.ambientLight,
+	                        instance.specular,
+	                        instance.specularLut,
+	                        instance.shadingMode,
+	                        camera,
+	                        {canvas.getWidth(), canvas.getHeight()},
+	                        instance.normalToCam,
+	                        *instance.lights,
+	                        instance.lightGrid,
+	                        gBuffer};
+
+	switch (settings.engine) {
+	case RasterEngine::Scanline:
+		drawFilledTriangle(canvas, depthBuffer, settings, scissor,
+		                   {roundSubpixel(triangle[0]), roundSubpixel(triangle[1]),
+		                    roundSubpixel(triangle[2])},
+		                   depth, normals, lighting, shading);
+		break;
+	case RasterEngine::Tiled:
+		drawFilledTriangleTiled(canvas, depthBuffer, settings, scissor, triangle, depth, normals,
+		                        lighting, shading);
+		break;
+	}
+}
+
+void drawOccluderTriangle(DepthBuffer& coarse, const int scale, const ivec2 canvasSize,
+                          const RasterEngine engine, const Triangle<ivec2>& triangle,
+                          const Triangle<real>& nearness) {
+	switch (engine) {
+	case RasterEngine::Scanline:
+		drawOccluderTriangleScanline(coarse, scale, canvasSize,
+		                             {roundSubpixel(triangle[0]), roundSubpixel(triangle[1]),
+		                              roundSubpixel(triangle[2])},
+		                             nearness);
+		break;
+	case RasterEngine::Tiled:
+		drawOccluderTriangleTiled(coarse, scale, canvasSize, triangle, nearness);
+		break;
+	}
 }
@@ -1,20 +1,152 @@
 #ifndef TRIANGLES_HPP
 #define TRIANGLES_HPP
 #include "../drawing/sextantBlocks.hpp"
+#include "deferred.hpp"
+#include "depthBuffer.hpp"
+#include "lightGrid.hpp"
+#include "lightTable.hpp"
 #include "renderable.hpp"
-#include <glm/ext/vector_double3.hpp>
+#include "settings.hpp"
+#include "shadeKernel.hpp"
 #include <glm/ext/vector_int2.hpp>
+#include <cmath>
 #include <memory>
 
-using glm::ivec2, glm::dvec3;
+using glm::ivec2;
+
+// Projected vertices are snapped to fixed point, with SUBPIXEL_BITS bits below a whole sextant.
+// The tiled engine rasterizes at that precision; the scanline engine rounds to whole sextants.
+constexpr int SUBPIXEL_BITS = 4;
+constexpr int SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+
+inline ivec2 toSubpixel(const rvec2 point) {
+	return {std::lround(point.x * SUBPIXEL_SCALE), std::lround(point.y * SUBPIXEL_SCALE)};
+}
+
+// whole sextants, rounding up (rounding down is just >> SUBPIXEL_BITS)
+inline int ceilSubpixel(const int value) { return (value + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS; }
+
+// the nearest whole sextant
+inline ivec2 roundSubpixel(const ivec2 point) {
+	return (point + SUBPIXEL_SCALE / 2) >> SUBPIXEL_BITS;
+}
+
+// Every sextant either engine could draw for a triangle with these (subpixel) vertices, in buffer
+// coordinates. Not clipped to anything.
+ScreenRect subpixelBounds(const Triangle<ivec2>& points, const ivec2 canvasSize);
+
+// A (loose) rectangle of buffer coordinates covering everything a camera space sphere projects
+// to. Not clipped to anything. False if the sphere reaches the viewport, since then it could
+// cover anything.
+bool sphereBounds(const Sphere& bounds, const Camera& camera, const ivec2 canvasSize,
+                  ScreenRect& out);
+
+// what a triangle needs for shading that's the same across its whole instance
+struct InstanceShading {
+	real ambientLight;
+	real specular;
+	rmat3 normalToCam; // object space normals to camera space, where everything's shaded
+	const LightTable* lights; // in camera space, and the same table for every instance
+	const LightGrid* lightGrid; // which lights reach where, or NULL to use them all everywhere
+	ShadingMode shadingMode;
+	const SpecularLut* specularLut; // NULL to use pow
+};
+
+// everything needed to shade a triangle's pixels that stays the same across the whole triangle
+struct TriangleShading {
+	Color color;
+	real ambientLight;
+	real specular;
+	const SpecularLut* specularLut; // NULL to use pow
+	ShadingMode shadingMode;
+	const Camera& camera;
+	ivec2 canvasSize;
+	rmat3 normalToCam; // object space normals to camera space, where everything's shaded
+	const LightTable& lights; // in camera space
+	const LightGrid* lightGrid; // NULL to use every light
+	GBuffer* gBuffer; // if not NULL, fragments go here instead of being shaded immediately
+};
+
+// fragments that passed the depth test, waiting to be shaded together
+struct FragmentBatch {
+	int count = 0;
+	int rows[SHADE_BATCH]; // where they go on the canvas
+	int cols[SHADE_BATCH];
+	ivec2 positions[SHADE_BATCH]; // the same pixels in canvas coordinates
+	real invDepths[SHADE_BATCH];
+	rvec3 normals[SHADE_BATCH]; // interpolated, so not normalized yet
+};
+
+// lighting intensity at a point, from ambient, diffuse, and specular
+// point, camera, normal, and lights must all be in the same coordinate space
+// specularLut is the table for specular, or NULL to use pow
+real computeLighting(const rvec3 point, const rvec3 camera, const rvec3 normal,
+                     const real specular, const real ambientLight,
+                     const LightTable& lights, const SpecularLut* specularLut);
+
+// the point drawn at pos, in camera space
+// pos is in canvas coordinates (origin at center)
+rvec3 fragmentCamPosition(const ivec2 pos, const real invDepth, const TriangleShading& shading);
+
+// computes the color of a pixel that already passed the depth test
+// pos is in canvas coordinates (origin at center)
+Color shadeFragment(const ivec2 pos, const real invDepth, const rvec3 interpNormal,
+                    const TriangleShading& shading);
+
+// shades every fragment in the batch and draws them, then empties it
+void flushFragments(SextantDrawing& canvas, FragmentBatch& batch, const TriangleShading& shading);
+
+// Stores a pixel that already passed the depth test: either queues it to be shaded with its
+// neighbors, records it in the G-buffer for the lighting pass, or (for Gouraud shading) draws it
+// with the interpolated vertex lighting.
+// Queued fragments aren't drawn until the batch fills up or flushFragments is called, so call that
+// once the triangle is done.
+// row and col index the canvas directly; pos is the same pixel in canvas coordinates.
+inline void writeFragment(SextantDrawing& canvas, FragmentBatch& batch, const int row,
+                          const int col, const ivec2 pos, const real invDepth,
+                          const rvec3 interpNormal, const real interpLighting,
+                          const TriangleShading& shading) {
+	if (shading.gBuffer != NULL) {
+		shading.gBuffer->set(row, col,
+		                     {static_cast<float>(invDepth),
+		                      glm::normalize(shading.normalToCam * interpNormal),
+		                      fragmentCamPosition(pos, invDepth, shading), shading.color,
+		                      shading.specular, shading.specularLut});
+		return;
+	}
+
+	if (shading.shadingMode == ShadingMode::Gouraud) {
+		canvas.set(SextantCoord(row, col),
+		           Color(shading.color.category, shading.color.color * interpLighting));
+		return;
+	}
+
+	batch.rows[batch.count] = row;
+	batch.cols[batch.count] = col;
+	batch.positions[batch.count] = pos;
+	batch.invDepths[batch.count] = invDepth;
+	batch.normals[batch.count] = interpNormal;
+	batch.count++;
+	if (batch.count == SHADE_BATCH) flushFragments(canvas, batch, shading);
+}
 
-// assumes x0 <= x1
-std::vector<double> interpolate(const int x0, const double y0, const int x1, const double y1);
 void drawLine(SextantDrawing& canvas, ivec2 p0, ivec2 p1, const Color color);
-void renderTriangle(SextantDrawing& canvas, boost::multi_array<float, 2>& depthBuffer,
+// Only the part of the triangle inside scissor (in buffer coordinates) is touched, including in
+// the depth buffer, so triangles with disjoint, tile aligned scissors can be drawn concurrently.
+// triangle is in subpixels (see SUBPIXEL_BITS). lighting is per vertex, and only used for Gouraud
+// shading.
+void renderTriangle(SextantDrawing& canvas, DepthBuffer& depthBuffer, GBuffer* gBuffer,
+                    const RenderSettings& settings, const ScreenRect& scissor,
                     const Triangle<ivec2>& triangle, const Triangle<float>& depth,
-                    const Triangle<dvec3> normals, const Color color, const double ambientLight,
-                    const double specular, const Camera& camera, const dmat4& camToObj,
-                    const std::vector<std::shared_ptr<Light>> lights);
+                    const Triangle<rvec3> normals, const Triangle<real>& lighting,
+                    const Color color, const Camera& camera, const InstanceShading& instance);
+
+// For occlusion culling: marks the cells of coarse (scale by scale blocks of a canvasSize canvas)
+// that engine certainly draws every sextant of when it draws the triangle, with the farthest
+// nearness it draws in them. Anything farther than a cell's value there is hidden once the
+// triangle is drawn. triangle is in subpixels, like for renderTriangle.
+void drawOccluderTriangle(DepthBuffer& coarse, const int scale, const ivec2 canvasSize,
+                          const RasterEngine engine, const Triangle<ivec2>& triangle,
+                          const Triangle<real>& nearness);
 
 #endif /* TRIANGLES_HPP */
@@ -0,0 +1,89 @@
+#include "vertexKernel.hpp"
+
+#include "lanes.hpp"
+
+void VertexStream::clear() {
+	this->objX.clear();
+	this->objY.clear();
+	this->objZ.clear();
+	this->reserved = 0;
+}
+
+size_t VertexStream::append(const std::vector<rvec3>& points) {
+	size_t first = this->objX.size();
+	for (const rvec3& point : points) {
+		this->objX.push_back(point.x);
+		this->objY.push_back(point.y);
+		this->objZ.push_back(point.z);
+	}
+
+	// pad to a whole register, so transformVertices never has to do part of one
+	while (this->objX.size() % Lanes::width != 0) {
+		this->objX.push_back(0);
+		this->objY.push_back(0);
+		this->objZ.push_back(0);
+	}
+	return first;
+}
+
+size_t VertexStream::reserveOutput(const size_t count) {
+	size_t first = this->reserved;
+	// a whole number of registers, like append
+	this->reserved += (count + Lanes::width - 1) / Lanes::width * Lanes::width;
+	return first;
+}
+
+void VertexStream::finish() {
+	this->camX.resize(this->reserved);
+	this->camY.resize(this->reserved);
+	this->camZ.resize(this->reserved);
+	this->canvasX.resize(this->reserved);
+	this->canvasY.resize(this->reserved);
+}
+
+void transformVertices(VertexStream& stream, const size_t source, const size_t target,
+                       const size_t count, const rmat4& toCam, const rmat3x4& projection) {
+	assertEq(source % Lanes::width, 0u, "Points must start at a whole register.");
+	assertEq(target % Lanes::width, 0u, "Points must go to a whole register.");
+	assertLtEq(source + count, stream.size(), "Source points out of range.");
+	assertLtEq(target + count, stream.camX.size(), "Call finish before transforming.");
+
+	Lanes m[4][4]; // toCam, in registers
+	for (int col = 0; col < 4; col++) {
+		for (int row = 0; row < 4; row++) {
+			m[col][row] = Lanes::fill(toCam[col][row]);
+		}
+	}
+	Lanes project[3][3]; // projection, in registers
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++) {
+			project[col][row] = Lanes::fill(projection[col][row]);
+		}
+	}
+	const Lanes zero = Lanes::fill(0);
+	const Lanes minDepth = Lanes::fill(0.001); // nearer than this (either way) won't project
+
+	// the arithmetic is grouped the same way glm's matrix products are
+	for (size_t i = 0; i < count; i += Lanes::width) {
+		Lanes x = Lanes::loadUnaligned(stream.objX.data() + source + i);
+		Lanes y = Lanes::loadUnaligned(stream.objY.data() + source + i);
+		Lanes z = Lanes::loadUnaligned(stream.objZ.data() + source + i);
+
+		// toCam * {x, y, z, 1}, then divided through by w
+		Lanes w = (m[0][3] * x + m[1][3] * y) + (m[2][3] * z + m[3][3]);
+		Lanes camX = ((m[0][0] * x + m[1][0] * y) + (m[2][0] * z + m[3][0])) / w;
+		Lanes camY = ((m[0][1] * x + m[1][1] * y) + (m[2][1] * z + m[3][1])) / w;
+		Lanes camZ = ((m[0][2] * x + m[1][2] * y) + (m[2][2] * z + m[3][2])) / w;
+		camX.storeUnaligned(stream.camX.data() + target + i);
+		camY.storeUnaligned(stream.camY.data() + target + i);
+		camZ.storeUnaligned(stream.camZ.data() + target + i);
+
+		// projection * {x, y, z}, then divided through by the last one
+		Lanes projX = project[0][0] * camX + project[1][0] * camY + project[2][0] * camZ;
+		Lanes projY = project[0][1] * camX + project[1][1] * camY + project[2][1] * camZ;
+		Lanes projZ = project[0][2] * camX + project[1][2] * camY + project[2][2] * camZ;
+		Lanes projectable = greater(max(projZ, zero - projZ), minDepth);
+		select(projectable, projX / projZ, zero).storeUnaligned(stream.canvasX.data() + target + i);
+		select(projectable, projY / projZ, zero).storeUnaligned(stream.canvasY.data() + target + i);
+	}
+}
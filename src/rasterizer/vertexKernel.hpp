@@ -0,0 +1,57 @@
+#ifndef VERTEXKERNEL_HPP
+#define VERTEXKERNEL_HPP
+#include "../extraAssertions.hpp"
+#include "precision.hpp"
+
+#include <vector>
+
+// Points from every instance that needs transforming, stored by field so transformVertices can
+// work on a whole register of them at once.
+// Meshes are appended once each, however many instances share them. Every instance then reserves
+// its own space in the outputs, and gets transformed into it with its own matrix.
+struct VertexStream {
+	// object space, from append
+	std::vector<real> objX;
+	std::vector<real> objY;
+	std::vector<real> objZ;
+	// camera space and canvas coordinates (not yet in subpixels), from transformVertices; indexed
+	// by where reserveOutput put them
+	std::vector<real> camX;
+	std::vector<real> camY;
+	std::vector<real> camZ;
+	std::vector<real> canvasX;
+	std::vector<real> canvasY;
+
+	// keeps the capacity
+	void clear();
+
+	// @return the index of the first point
+	size_t append(const std::vector<rvec3>& points);
+
+	// @return the index in the outputs of the first of count points
+	size_t reserveOutput(const size_t count);
+
+	// sizes the outputs to fit everything reserved; call once that's all done
+	void finish();
+
+	[[nodiscard]] size_t size() const { return this->objX.size(); }
+
+	[[nodiscard]] size_t outputSize() const { return this->reserved; }
+
+	[[nodiscard]] rvec3 getCamera(const size_t i) const {
+		return {this->camX[i], this->camY[i], this->camZ[i]};
+	}
+
+  private:
+	size_t reserved = 0; // points in the outputs, once finished
+};
+
+// Moves count points, starting at source, into camera space with toCam, then projects them with
+// projection (from Camera::viewportTransform), writing them to the outputs starting at target.
+// Same results as doing it with glm one point at a time, including the points too close to the
+// camera to project getting {0, 0}.
+// Uses AVX2 when built with PLAY3D_SIMD, and a plain loop otherwise.
+void transformVertices(VertexStream& stream, const size_t source, const size_t target,
+                       const size_t count, const rmat4& toCam, const rmat3x4& projection);
+
+#endif /* VERTEXKERNEL_HPP */
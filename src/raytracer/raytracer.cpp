@@ -1,6 +1,7 @@
 #include "raytracer.hpp"
 #include "../drawing/setColor.hpp"
 #include "../extraAssertions.hpp"
+#include "../util/specularLut.hpp"
 #include <csignal>
 #include <format>
 #include <glm/ext/matrix_double3x3.hpp>
@@ -33,6 +34,7 @@ struct Sphere {
 	Color color;
 	double specular; // [0, inf)
 	double reflective; // [0, 1]
+	const SpecularLut* specularLut = NULL; // filled in by makeScene
 };
 
 enum class LightType { Point, Directional };
@@ -130,7 +132,8 @@ SphereDist closestIntersection(const Scene& scene, const dvec3 origin, const dve
 }
 
 static double computeLighting(const Scene& scene, const dvec3 point, const dvec3 normal,
-                       const dvec3 exitVec, const double specular) {
+                       const dvec3 exitVec, const double specular,
+                       const SpecularLut* specularLut) {
 	double intensity = scene.ambientLight;
 
 	for (const std::shared_ptr<const Light> light : scene.lights) {
@@ -164,10 +167,8 @@ static double computeLighting(const Scene& scene, const dvec3 point, const dvec3
 			dvec3 reflected = reflectRay(lightDir, normal);
 			double reflectedDotExit = glm::dot(reflected, exitVec);
 			if (reflectedDotExit > 0) {
-				intensity +=
-				    light->getIntensity()
-				    * pow(reflectedDotExit / (glm::length(reflected) * glm::length(exitVec)),
-				          specular);
+				double cosine = reflectedDotExit / (glm::length(reflected) * glm::length(exitVec));
+				intensity += light->getIntensity() * specularLut->at(cosine);
 			}
 		}
 	}
@@ -187,7 +188,8 @@ Color traceRay(const Scene& scene, const dvec3 origin, const dvec3 direction, co
 	normal = glm::normalize(normal);
 	Color localColor = closest.sphere.color;
 	localColor.color *=
-	    computeLighting(scene, intersection, normal, -direction, closest.sphere.specular);
+	    computeLighting(scene, intersection, normal, -direction, closest.sphere.specular,
+	                    closest.sphere.specularLut);
 
 	// if we've hit the recursion limit or the intersected sphere isn't reflective, we're done
 	if (recursionLimit == 0 || closest.sphere.reflective <= 0.0) {
@@ -206,9 +208,8 @@ Color traceRay(const Scene& scene, const dvec3 origin, const dvec3 direction, co
 	return Color(localColor.category, combinedColor); // always use this object's category
 }
 
-void rayRenderLoop(WindowedDrawing& rawCanvas, const bool& exit_requested,
-                   std::function<int()> refresh) {
-	const static Scene scene{
+static Scene makeScene() {
+	Scene scene{
 	    {
          Sphere(dvec3{0.0, -1.0, 3.0}, 1.0, Color{Category{true, 9}, RGBA{255, 0, 0, 255}}, 500,
          0.2),
@@ -226,6 +227,16 @@ void rayRenderLoop(WindowedDrawing& rawCanvas, const bool& exit_requested,
 	     }
     };
 
+	for (Sphere& sphere : scene.spheres) {
+		if (sphere.specular != -1) sphere.specularLut = &specularLutFor(sphere.specular);
+	}
+	return scene;
+}
+
+void rayRenderLoop(WindowedDrawing& rawCanvas, const bool& exit_requested,
+                   std::function<int()> refresh) {
+	const static Scene scene = makeScene();
+
 	int minDimension = std::min(rawCanvas.getHeight(), rawCanvas.getWidth() / 2);
 	SextantDrawing canvas{minDimension, minDimension * 2};
 	dvec3 origin = dvec3();
@@ -0,0 +1,45 @@
+#include "frameArena.hpp"
+
+#include <bit>
+#include <cstdint>
+
+FrameArena::FrameArena(const size_t initialCapacity) : capacity(initialCapacity) {
+	if (initialCapacity != 0)
+		this->block = std::make_unique_for_overwrite<std::byte[]>(initialCapacity);
+}
+
+void* FrameArena::do_allocate(const size_t bytes, const size_t alignment) {
+	assertMsg(std::has_single_bit(alignment), "Alignments must be powers of 2.");
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(this->block.get());
+	size_t start = ((base + this->offset + alignment - 1) & ~(alignment - 1)) - base;
+	if (this->block != NULL and start + bytes <= this->capacity) {
+		this->used += start + bytes - this->offset;
+		this->offset = start + bytes;
+		return this->block.get() + start;
+	}
+
+	// doesn't fit, so it gets a block of its own until the next reset
+	size_t size = bytes + alignment;
+	this->overflow.push_back(std::make_unique_for_overwrite<std::byte[]>(size));
+	this->overflowBytes += size;
+	this->used += size;
+
+	void* out = this->overflow.back().get();
+	return std::align(alignment, bytes, out, size);
+}
+
+void FrameArena::reset() {
+	this->peak = std::max(this->peak, this->used);
+
+	if (not this->overflow.empty()) {
+		// all of this frame in one block, with some room for the next one to grow
+		this->capacity = (this->offset + this->overflowBytes) * 3 / 2;
+		this->block = std::make_unique_for_overwrite<std::byte[]>(this->capacity);
+		this->overflow.clear();
+		this->overflowBytes = 0;
+	}
+
+	this->offset = 0;
+	this->used = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef FRAMEARENA_HPP
+#define FRAMEARENA_HPP
+#include "../extraAssertions.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// A bump allocator for things that only live for one frame: allocating just moves a pointer along,
+// freeing does nothing, and reset() takes everything back at once. Use it through std::pmr
+// containers.
+// Whatever doesn't fit gets a block of its own from the heap. The next reset replaces all of them
+// with one block big enough for the whole frame, so once frames stop growing they never touch
+// malloc at all.
+// Not thread safe.
+class FrameArena : public std::pmr::memory_resource {
+  private:
+	std::unique_ptr<std::byte[]> block;
+	size_t capacity = 0;
+	size_t offset = 0; // how much of block is in use
+	std::vector<std::unique_ptr<std::byte[]>> overflow; // this frame's blocks that didn't fit
+	size_t overflowBytes = 0;
+	size_t used = 0; // handed out since the last reset, including padding
+	size_t peak = 0;
+
+	void* do_allocate(const size_t bytes, const size_t alignment) override;
+
+	// everything is freed by reset
+	void do_deallocate(void*, size_t, size_t) override {}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+
+  public:
+	explicit FrameArena(const size_t initialCapacity = 0);
+
+	// frees everything allocated since the last reset
+	void reset();
+
+	// since the last reset
+	[[nodiscard]] size_t bytesUsed() const { return this->used; }
+
+	// the most any frame has used
+	[[nodiscard]] size_t peakBytesUsed() const { return std::max(this->peak, this->used); }
+
+	[[nodiscard]] size_t getCapacity() const { return this->capacity; }
+
+	// how many times this frame had to go to the heap
+	[[nodiscard]] size_t overflowCount() const { return this->overflow.size(); }
+};
+
+#endif /* FRAMEARENA_HPP */
@@ -0,0 +1,30 @@
+#include "specularLut.hpp"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+SpecularLut::SpecularLut(const double exponent) : exponent(exponent) {
+	assertGtEq(exponent, 0, "Specular exponents can't be negative.");
+
+	// cosine^exponent = cutoff solved for the cosine; a flat highlight (exponent 0) needs all of it
+	this->start = exponent > 0 ? std::pow(SPECULAR_LUT_CUTOFF, 1 / exponent) : 0;
+	// keep at least one step, even for exponents so big the start rounds to 1
+	this->start = std::min(this->start, 1 - 1.0 / (1 << 20));
+	this->scale = SPECULAR_LUT_SIZE / (1 - this->start);
+
+	for (int i = 0; i <= SPECULAR_LUT_SIZE; i++) {
+		this->samples[i] = std::pow(this->start + i / this->scale, exponent);
+	}
+}
+
+const SpecularLut& specularLutFor(const double exponent) {
+	static std::mutex lock;
+	static std::map<double, std::unique_ptr<SpecularLut>> tables;
+
+	std::lock_guard guard{lock};
+	std::unique_ptr<SpecularLut>& table = tables[exponent];
+	if (table == NULL) table = std::make_unique<SpecularLut>(exponent);
+	return *table;
+}
@@ -0,0 +1,43 @@
+#ifndef SPECULARLUT_HPP
+#define SPECULARLUT_HPP
+#include "../extraAssertions.hpp"
+
+#include <algorithm>
+#include <array>
+
+// how many steps a table is split into
+constexpr int SPECULAR_LUT_SIZE = 1024;
+// highlights dimmer than this are left out (well below one step of an 8 bit color)
+constexpr double SPECULAR_LUT_CUTOFF = 1.0 / 4096;
+
+// cosine^exponent for specular highlights, tabulated since pow is the slowest part of lighting.
+// Big exponents only light up cosines very close to 1, so rather than spreading the samples over
+// [0, 1] the table starts where the highlight gets brighter than SPECULAR_LUT_CUTOFF, and is 0
+// below that. Values in between samples are interpolated linearly.
+class SpecularLut {
+  private:
+	double exponent;
+	double start; // the cosine the first sample is at
+	double scale; // samples per unit of cosine
+	std::array<float, SPECULAR_LUT_SIZE + 1> samples;
+
+  public:
+	explicit SpecularLut(const double exponent);
+
+	double getExponent() const { return this->exponent; }
+
+	// cosine should be in [0, 1]
+	double at(const double cosine) const {
+		if (cosine <= this->start) return 0;
+		double position = (cosine - this->start) * this->scale;
+		int index = std::min(static_cast<int>(position), SPECULAR_LUT_SIZE - 1);
+		double fraction = position - index;
+		return this->samples[index] + (this->samples[index + 1] - this->samples[index]) * fraction;
+	}
+};
+
+// The table for the exponent, built the first time any object asks for it and shared from then
+// on. Thread safe, and the table lives until the program exits.
+const SpecularLut& specularLutFor(const double exponent);
+
+#endif /* SPECULARLUT_HPP */
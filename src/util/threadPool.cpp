@@ -0,0 +1,106 @@
+#include "threadPool.hpp"
+
+ThreadPool::ThreadPool(const uint size) {
+	assertGt(size, 0u, "A thread pool needs at least one thread.");
+	for (uint i = 0; i < size; i++) {
+		this->queues.push_back(std::make_unique<Queue>());
+	}
+	// the caller is worker 0, so it doesn't get a thread
+	for (uint i = 1; i < size; i++) {
+		this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard guard{this->lock};
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (std::thread& thread : this->threads) {
+		thread.join();
+	}
+}
+
+bool ThreadPool::takeJob(const uint self, size_t& out) {
+	// Own jobs come off the front, so each worker goes through its chunk in order. Stolen ones come
+	// off the back, which is as far as possible from what the owner is working on.
+	for (uint i = 0; i < this->queues.size(); i++) {
+		Queue& queue = *this->queues[(self + i) % this->queues.size()];
+		uint64_t range = queue.range.load(std::memory_order_relaxed);
+		while (true) {
+			uint32_t first = range, end = range >> 32;
+			if (first >= end) break;
+			uint64_t left = i == 0 ? (uint64_t{end} << 32) | (first + 1)
+			                       : (uint64_t{end - 1} << 32) | first;
+			if (queue.range.compare_exchange_weak(range, left, std::memory_order_relaxed)) {
+				out = i == 0 ? first : end - 1;
+				return true;
+			}
+		}
+	}
+	return false; // nothing is ever added mid-loop, so everything's been taken
+}
+
+void ThreadPool::runJobs(const uint self, const JobRef& job) {
+	size_t index;
+	while (this->takeJob(self, index)) {
+		job(index);
+	}
+}
+
+void ThreadPool::workerLoop(const uint self) {
+	uint seen = 0;
+	while (true) {
+		const JobRef* job;
+		{
+			std::unique_lock guard{this->lock};
+			this->wake.wait(guard, [&] { return this->stopping or this->generation != seen; });
+			if (this->stopping) return;
+			seen = this->generation;
+			job = this->job;
+		}
+
+		this->runJobs(self, *job);
+
+		{
+			std::lock_guard guard{this->lock};
+			this->working--;
+		}
+		this->finished.notify_one();
+	}
+}
+
+void ThreadPool::parallelFor(const size_t count, const JobRef job) {
+	if (this->threads.empty()) {
+		for (size_t i = 0; i < count; i++) {
+			job(i);
+		}
+		return;
+	}
+
+	// Hand out contiguous chunks, so neighboring jobs (usually neighboring tiles) tend to stay on
+	// one thread. Stealing evens things out from there.
+	// The threads only look at them after taking the lock below, which publishes them.
+	assertLtEq(count, size_t{UINT32_MAX}, "Too many jobs for one loop.");
+	for (uint worker = 0; worker < this->size(); worker++) {
+		uint64_t first = count * worker / this->size();
+		uint64_t end = count * (worker + 1) / this->size();
+		this->queues[worker]->range.store((end << 32) | first, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard guard{this->lock};
+		this->job = &job;
+		this->working = this->threads.size();
+		this->generation++;
+	}
+	this->wake.notify_all();
+
+	this->runJobs(0, job);
+
+	// every thread has to check in before returning, since they still hold a pointer to job
+	std::unique_lock guard{this->lock};
+	this->finished.wait(guard, [this] { return this->working == 0; });
+	this->job = NULL;
+}
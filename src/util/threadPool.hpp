@@ -0,0 +1,76 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+#include "../extraAssertions.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Something callable as void(size_t), without owning it or ever allocating like std::function
+// can. Whatever it refers to has to outlive it; passing a lambda straight to parallelFor is fine.
+class JobRef {
+  private:
+	void* function;
+	void (*call)(void* function, size_t index);
+
+  public:
+	template <typename Function>
+	    requires(not std::is_same_v<std::remove_cvref_t<Function>, JobRef>)
+	JobRef(Function&& function)
+	    : function(const_cast<void*>(static_cast<const void*>(&function))),
+	      call([](void* function, size_t index) {
+		      (*static_cast<std::remove_reference_t<Function>*>(function))(index);
+	      }) {}
+
+	void operator()(const size_t index) const { this->call(this->function, index); }
+};
+
+// A fixed set of threads for running parallel loops.
+// Every thread has its own range of jobs, and steals from the others once it runs out, so an
+// uneven split (one tile with most of the triangles, say) still keeps everyone busy.
+// The calling thread works too, so a pool of size 1 starts no threads at all. Nothing is
+// allocated after the pool is made.
+class ThreadPool {
+  private:
+	// The jobs a worker has left, as [first, end) packed into one word (first in the low half),
+	// so taking one from either end is a single compare and swap. On its own cache line, since
+	// every worker hammers its own.
+	struct alignas(64) Queue {
+		std::atomic<uint64_t> range{0};
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Queue>> queues; // queue 0 is the caller's, the rest are threads'
+
+	std::mutex lock; // guards everything below
+	std::condition_variable wake; // for the threads, when there's work or they should stop
+	std::condition_variable finished; // for the caller, when the last thread is done
+	const JobRef* job = NULL;
+	uint generation = 0; // bumped on every parallelFor, so threads can tell there's new work
+	uint working = 0; // threads that haven't finished the current generation
+	bool stopping = false;
+
+	bool takeJob(const uint self, size_t& out);
+	void runJobs(const uint self, const JobRef& job);
+	void workerLoop(const uint self);
+
+  public:
+	explicit ThreadPool(const uint size);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	[[nodiscard]] uint size() const { return this->queues.size(); }
+
+	// Calls job(i) for every i in [0, count) across the pool, and returns once they're all done.
+	// Jobs run in no particular order, so they must not depend on each other.
+	void parallelFor(const size_t count, const JobRef job);
+};
+
+#endif /* THREADPOOL_HPP */